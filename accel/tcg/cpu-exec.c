@@ -238,6 +238,117 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, vaddr pc,
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
+static CPUJumpCache *tb_jmp_cache_new(unsigned bits)
+{
+    CPUJumpCache *jc = g_malloc0(sizeof(CPUJumpCache) +
+                                 (sizeof(CPUJumpCacheEntry) << bits));
+
+    jc->bits = bits;
+    return jc;
+}
+
+/*
+ * Install @tb for @pc in entry @hash of @jc, and move the TB that it
+ * replaces to the victim tier.  Only called by the owner of @jc.
+ */
+static void tb_jmp_cache_insert(CPUJumpCache *jc, uint32_t hash, vaddr pc,
+                                TranslationBlock *tb)
+{
+    CPUJumpCacheEntry *e = &jc->array[hash];
+    TranslationBlock *old = qatomic_read(&e->tb);
+
+    if (old && old != tb) {
+        CPUJumpCacheEntry *v = &jc->victim[jc->victim_next];
+
+        jc->victim_next = (jc->victim_next + 1) % TB_JMP_VICTIM_SIZE;
+        v->pc = e->pc;
+        /* Ensure pc is written first. */
+        qatomic_store_release(&v->tb, old);
+    }
+    e->pc = pc;
+    /* Ensure pc is written first. */
+    qatomic_store_release(&e->tb, tb);
+}
+
+static TranslationBlock *tb_jmp_cache_victim_lookup(CPUJumpCache *jc,
+                                                    vaddr pc,
+                                                    uint64_t cs_base,
+                                                    uint32_t flags,
+                                                    uint32_t cflags)
+{
+    for (int i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+        CPUJumpCacheEntry *v = &jc->victim[i];
+        /* Use acquire to ensure current load of pc from jc. */
+        TranslationBlock *tb = qatomic_load_acquire(&v->tb);
+
+        if (tb &&
+            v->pc == pc &&
+            tb->cs_base == cs_base &&
+            tb->flags == flags &&
+            tb_cflags(tb) == cflags) {
+            /* It moves back to the direct-mapped array */
+            qatomic_set(&v->tb, NULL);
+            return tb;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Resize the jump cache at the end of a window of misses, in the spirit
+ * of tlb_mmu_resize_locked(): double it when more than one lookup in 8
+ * missed, and halve it again when fewer than one in 256 did.  A window
+ * lasts for 1/16 as many misses as there are entries.
+ *
+ * The entries are carried over.  Another thread may invalidate a TB
+ * while they are copied, but lookups then miss on its CF_INVALID flag.
+ */
+static CPUJumpCache *tb_jmp_cache_resize(CPUState *cpu, CPUJumpCache *jc)
+{
+    size_t lookups = jc->hits + jc->victim_hits + jc->misses;
+    size_t window_misses = jc->misses - jc->window_misses;
+    size_t window_lookups = lookups - jc->window_lookups;
+    unsigned bits = jc->bits;
+    CPUJumpCache *new_jc;
+    size_t i;
+
+    if (window_misses < tb_jmp_cache_size(jc) / 16) {
+        return jc;
+    }
+    jc->window_misses = jc->misses;
+    jc->window_lookups = lookups;
+
+    if (window_lookups < window_misses * 8) {
+        bits = MIN(bits + 1, TB_JMP_CACHE_MAX_BITS);
+    } else if (window_lookups > window_misses * 256) {
+        bits = MAX(bits - 1, TB_JMP_CACHE_BITS);
+    }
+    if (bits == jc->bits) {
+        return jc;
+    }
+
+    new_jc = tb_jmp_cache_new(bits);
+    new_jc->hits = jc->hits;
+    new_jc->victim_hits = jc->victim_hits;
+    new_jc->misses = jc->misses;
+    new_jc->window_misses = jc->window_misses;
+    new_jc->window_lookups = jc->window_lookups;
+    for (i = 0; i < tb_jmp_cache_size(jc) + TB_JMP_VICTIM_SIZE; i++) {
+        CPUJumpCacheEntry *e = i < tb_jmp_cache_size(jc) ?
+            &jc->array[i] : &jc->victim[i - tb_jmp_cache_size(jc)];
+        TranslationBlock *tb = qatomic_load_acquire(&e->tb);
+
+        if (tb) {
+            tb_jmp_cache_insert(new_jc, tb_jmp_cache_hash_func(new_jc, e->pc),
+                                e->pc, tb);
+        }
+    }
+
+    qatomic_rcu_set(&cpu->tb_jmp_cache, new_jc);
+    g_free_rcu(jc, rcu);
+    return new_jc;
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                                           uint64_t cs_base, uint32_t flags,
@@ -250,8 +361,8 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
     jc = cpu->tb_jmp_cache;
+    hash = tb_jmp_cache_hash_func(jc, pc);
 
     if (cflags & CF_PCREL) {
         /* Use acquire to ensure current load of pc from jc. */
@@ -262,15 +373,9 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                    tb->cs_base == cs_base &&
                    tb->flags == flags &&
                    tb_cflags(tb) == cflags)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
             return tb;
         }
-        tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
-        if (tb == NULL) {
-            return NULL;
-        }
-        jc->array[hash].pc = pc;
-        /* Ensure pc is written first. */
-        qatomic_store_release(&jc->array[hash].tb, tb);
     } else {
         /* Use rcu_read to ensure current load of pc from *tb. */
         tb = qatomic_rcu_read(&jc->array[hash].tb);
@@ -280,15 +385,25 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                    tb->cs_base == cs_base &&
                    tb->flags == flags &&
                    tb_cflags(tb) == cflags)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
             return tb;
         }
+    }
+
+    tb = tb_jmp_cache_victim_lookup(jc, pc, cs_base, flags, cflags);
+    if (tb) {
+        qatomic_set(&jc->victim_hits, jc->victim_hits + 1);
+    } else {
+        qatomic_set(&jc->misses, jc->misses + 1);
+        jc = tb_jmp_cache_resize(cpu, jc);
+        hash = tb_jmp_cache_hash_func(jc, pc);
+
         tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
         if (tb == NULL) {
             return NULL;
         }
-        /* Use the pc value already stored in tb->pc. */
-        qatomic_set(&jc->array[hash].tb, tb);
     }
+    tb_jmp_cache_insert(jc, hash, pc, tb);
 
     return tb;
 }
@@ -1000,7 +1115,6 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
             if (tb == NULL) {
                 CPUJumpCache *jc;
-                uint32_t h;
 
                 mmap_lock();
                 tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
@@ -1010,16 +1124,9 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
                 jc = cpu->tb_jmp_cache;
-                if (cflags & CF_PCREL) {
-                    jc->array[h].pc = pc;
-                    /* Ensure pc is written first. */
-                    qatomic_store_release(&jc->array[h].tb, tb);
-                } else {
-                    /* Use the pc value already stored in tb->pc. */
-                    qatomic_set(&jc->array[h].tb, tb);
-                }
+                tb_jmp_cache_insert(jc, tb_jmp_cache_hash_func(jc, pc),
+                                    pc, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1099,7 +1206,7 @@ bool tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = tb_jmp_cache_new(TB_JMP_CACHE_BITS);
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
@@ -9,20 +9,44 @@
 #ifndef ACCEL_TCG_TB_JMP_CACHE_H
 #define ACCEL_TCG_TB_JMP_CACHE_H
 
+/* The cache starts at the minimum size and grows with its miss rate */
 #define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_MAX_BITS 16
+#define TB_JMP_VICTIM_SIZE 8
+
+typedef struct CPUJumpCacheEntry {
+    TranslationBlock *tb;
+    vaddr pc;
+} CPUJumpCacheEntry;
 
 /*
  * Accessed in parallel; all accesses to 'tb' must be atomic.
  * For CF_PCREL, accesses to 'pc' must be protected by a
- * load_acquire/store_release to 'tb'.
+ * load_acquire/store_release to 'tb'.  The same holds for the
+ * victim tier, whose 'pc' is always valid.
+ *
+ * Only the owner CPU replaces the cache when it resizes it; other
+ * threads must read cpu->tb_jmp_cache within an RCU read section.
  */
 struct CPUJumpCache {
     struct rcu_head rcu;
-    struct {
-        TranslationBlock *tb;
-        vaddr pc;
-    } array[TB_JMP_CACHE_SIZE];
+    unsigned bits;
+    /* Statistics, written by the owner only */
+    size_t hits;
+    size_t victim_hits;
+    size_t misses;
+    /* Lookups and misses when the current resize window began */
+    size_t window_lookups;
+    size_t window_misses;
+    /* Entries evicted from the direct-mapped array, filled round-robin */
+    unsigned victim_next;
+    CPUJumpCacheEntry victim[TB_JMP_VICTIM_SIZE];
+    CPUJumpCacheEntry array[];
 };
 
+static inline size_t tb_jmp_cache_size(const CPUJumpCache *jc)
+{
+    return (size_t)1 << jc->bits;
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
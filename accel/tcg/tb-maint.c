@@ -884,14 +884,21 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
+        /* The owner of each cache may resize it meanwhile */
+        RCU_READ_LOCK_GUARD();
 
         CPU_FOREACH(cpu) {
-            CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+            uint32_t h = tb_jmp_cache_hash_func(jc, tb->pc);
 
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            for (int i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+                if (qatomic_read(&jc->victim[i].tb) == tb) {
+                    qatomic_set(&jc->victim[i].tb, NULL);
+                }
+            }
         }
     }
 }
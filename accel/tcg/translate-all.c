@@ -662,14 +662,21 @@ void cpu_interrupt(CPUState *cpu, int mask)
  */
 void tcg_flush_jmp_cache(CPUState *cpu)
 {
-    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    /* The owner of the cache may resize it meanwhile */
+    RCU_READ_LOCK_GUARD();
+    jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
     /* During early initialization, the cache may not yet be allocated. */
     if (unlikely(jc == NULL)) {
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (size_t i = 0; i < tb_jmp_cache_size(jc); i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
+    for (int i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+        qatomic_set(&jc->victim[i].tb, NULL);
+    }
 }
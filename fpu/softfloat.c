@@ -86,6 +86,9 @@ this code that are retained.
 #include <math.h>
 #include "qemu/bitops.h"
 #include "fpu/softfloat.h"
+#ifdef CONFIG_AVX2_OPT
+#include "host/cpuinfo.h"
+#endif
 
 /* We only need stdlib for abort() */
 
@@ -2870,6 +2873,149 @@ bfloat16 float64_to_bfloat16(float64 a, float_status *s)
     return bfloat16_round_pack_canonical(&p, s);
 }
 
+/*
+ * Bulk float32 <-> bfloat16 conversions.
+ *
+ * Blocks of BF16_BLOCK elements are converted with integer arithmetic,
+ * which the compiler vectorizes, when no element needs more than that:
+ * narrowing is then a round to nearest even of the low 16 bits that can
+ * only raise inexact, and widening is exact.  A block that holds an
+ * element the shortcut does not cover (subnormal, near the overflow
+ * threshold, infinity or NaN) is converted one element at a time with
+ * the functions above, so that results and flags are identical to them.
+ *
+ * Each block is read in full before it is written, which makes it safe
+ * for the destination to overlap the source in the ways that the vector
+ * narrowing and widening instructions allow.
+ */
+#define BF16_BLOCK  16
+
+static inline QEMU_ALWAYS_INLINE bool
+f32_to_bf16_block(bfloat16 *d, const float32 *s, bool *inexact)
+{
+    uint32_t x[BF16_BLOCK], low = 0;
+    uint16_t r[BF16_BLOCK];
+    bool special = false;
+    int i;
+
+    memcpy(x, s, sizeof(x));
+    for (i = 0; i < BF16_BLOCK; i++) {
+        uint32_t exp = extract32(x[i], 23, 8);
+
+        /* zeroes are exact, other exponents 0, 0xfe and 0xff are not */
+        special |= (x[i] << 1) != 0 && exp - 1 >= 0xfd;
+        low |= x[i] & 0xffff;
+        r[i] = (x[i] + 0x7fff + extract32(x[i], 16, 1)) >> 16;
+    }
+    if (special) {
+        return false;
+    }
+    memcpy(d, r, sizeof(r));
+    *inexact |= low != 0;
+    return true;
+}
+
+static inline QEMU_ALWAYS_INLINE bool
+bf16_to_f32_block(float32 *d, const bfloat16 *s)
+{
+    uint16_t x[BF16_BLOCK];
+    uint32_t r[BF16_BLOCK];
+    bool special = false;
+    int i;
+
+    memcpy(x, s, sizeof(x));
+    for (i = 0; i < BF16_BLOCK; i++) {
+        uint32_t exp = extract32(x[i], 7, 8);
+
+        /* NaNs, and denormals that either flush mode may flush */
+        special |= (x[i] & 0x7f) != 0 && (exp == 0 || exp == 0xff);
+        r[i] = (uint32_t)x[i] << 16;
+    }
+    if (special) {
+        return false;
+    }
+    memcpy(d, r, sizeof(r));
+    return true;
+}
+
+static inline QEMU_ALWAYS_INLINE void
+f32_to_bf16_n(bfloat16 *d, const float32 *s, size_t n, float_status *st)
+{
+    bool inexact = false;
+    size_t i = 0, j;
+
+    if (st->float_rounding_mode == float_round_nearest_even) {
+        for (; i + BF16_BLOCK <= n; i += BF16_BLOCK) {
+            if (!f32_to_bf16_block(d + i, s + i, &inexact)) {
+                for (j = i; j < i + BF16_BLOCK; j++) {
+                    d[j] = float32_to_bfloat16(s[j], st);
+                }
+            }
+        }
+    }
+    for (; i < n; i++) {
+        d[i] = float32_to_bfloat16(s[i], st);
+    }
+    if (inexact) {
+        float_raise(float_flag_inexact, st);
+    }
+}
+
+static inline QEMU_ALWAYS_INLINE void
+bf16_to_f32_n(float32 *d, const bfloat16 *s, size_t n, float_status *st)
+{
+    size_t i = 0, j;
+
+    for (; i + BF16_BLOCK <= n; i += BF16_BLOCK) {
+        if (!bf16_to_f32_block(d + i, s + i)) {
+            for (j = i; j < i + BF16_BLOCK; j++) {
+                d[j] = bfloat16_to_float32(s[j], st);
+            }
+        }
+    }
+    for (; i < n; i++) {
+        d[i] = bfloat16_to_float32(s[i], st);
+    }
+}
+
+#ifdef CONFIG_AVX2_OPT
+static void __attribute__((target("avx2")))
+f32_to_bf16_n_avx2(bfloat16 *d, const float32 *s, size_t n, float_status *st)
+{
+    f32_to_bf16_n(d, s, n, st);
+}
+
+static void __attribute__((target("avx2")))
+bf16_to_f32_n_avx2(float32 *d, const bfloat16 *s, size_t n, float_status *st)
+{
+    bf16_to_f32_n(d, s, n, st);
+}
+#endif
+
+void float32_to_bfloat16_n(bfloat16 *d, const float32 *s, size_t n,
+                           float_status *st)
+{
+#ifdef CONFIG_AVX2_OPT
+    if (cpuinfo & CPUINFO_AVX2) {
+        f32_to_bf16_n_avx2(d, s, n, st);
+        return;
+    }
+#endif
+    f32_to_bf16_n(d, s, n, st);
+}
+
+void bfloat16_to_float32_n(float32 *d, const bfloat16 *s, size_t n,
+                           float_status *st)
+{
+#ifdef CONFIG_AVX2_OPT
+    if (cpuinfo & CPUINFO_AVX2) {
+        bf16_to_f32_n_avx2(d, s, n, st);
+        return;
+    }
+#endif
+    bf16_to_f32_n(d, s, n, st);
+}
+
 float32 float128_to_float32(float128 a, float_status *s)
 {
     FloatParts64 p64;
@@ -10,8 +10,14 @@
 #include "hw/dma/atcdmac300.h"
 #include "hw/irq.h"
 #include "hw/qdev-properties.h"
+#include "qemu/host-utils.h"
 #include "qemu/log.h"
+#include "qemu/main-loop.h"
 #include "qemu/module.h"
+#include "qemu/rcu.h"
+#include "qemu/timer.h"
+#include "exec/address-spaces.h"
+#include "sysemu/dma.h"
 
 /* #define DEBUG_ANDES_ATCDMAC300 */
 #define LOGGE(x...) qemu_log_mask(LOG_GUEST_ERROR, x)
@@ -84,15 +90,357 @@ static uint64_t atcdmac300_read(void *opaque, hwaddr offset, unsigned size)
     return result;
 }
 
+static bool atcdmac300_is_ram(ATCDMAC300State *s, hwaddr addr, bool is_write)
+{
+    MemoryRegion *mr;
+    hwaddr xlat, len = 1;
+
+    RCU_READ_LOCK_GUARD();
+    mr = address_space_translate(s->as, addr, &xlat, &len, is_write,
+                                 MEMTXATTRS_UNSPECIFIED);
+    return memory_access_is_direct(mr, is_write);
+}
+
+/*
+ * Copy an incrementing transfer with address_space_map, so contiguous RAM
+ * is copied with one memmove per mapping.  Returns the number of bytes
+ * copied, 0 if either side isn't RAM: device registers must see accesses
+ * of the programmed width.
+ */
+static uint64_t atcdmac300_copy_bulk(ATCDMAC300State *s, ATCDMAC300Chan *c,
+                                     uint64_t size)
+{
+    hwaddr src_len = size, dst_len = size;
+    void *src, *dst;
+    uint64_t len;
+
+    if (!atcdmac300_is_ram(s, c->src, false) ||
+        !atcdmac300_is_ram(s, c->dst, true)) {
+        return 0;
+    }
+    src = address_space_map(s->as, c->src, &src_len, false,
+                            MEMTXATTRS_UNSPECIFIED);
+    if (!src) {
+        return 0;
+    }
+    dst = address_space_map(s->as, c->dst, &dst_len, true,
+                            MEMTXATTRS_UNSPECIFIED);
+    if (!dst) {
+        address_space_unmap(s->as, src, src_len, false, 0);
+        return 0;
+    }
+    len = MIN(src_len, dst_len);
+    memmove(dst, src, len);
+    address_space_unmap(s->as, dst, dst_len, true, len);
+    address_space_unmap(s->as, src, src_len, false, len);
+    return len;
+}
+
+/*
+ * Move a transfer between RAM and the fixed FIFO address of a device that
+ * implements TYPE_ATCDMAC300_PERIPH with a single burst.  Returns the
+ * number of bytes moved, 0 if the transfer has to go element by element.
+ */
+static uint64_t atcdmac300_copy_periph(ATCDMAC300State *s, ATCDMAC300Chan *c,
+                                       uint64_t size)
+{
+    uint32_t width = MAX(c->src_width, c->dst_width);
+    hwaddr fifo, ram, xlat, fifo_len = width, ram_len;
+    ATCDMAC300PeriphClass *pc;
+    MemoryRegion *mr;
+    Object *owner;
+    bool to_dev;
+    uint64_t len;
+    void *host;
+
+    if (c->src_ctl == CHAN_CTL_ADDR_CTL_FIXED &&
+        c->dst_ctl == CHAN_CTL_ADDR_CTL_INC) {
+        to_dev = false;
+        fifo = c->src;
+        ram = c->dst;
+    } else if (c->src_ctl == CHAN_CTL_ADDR_CTL_INC &&
+               c->dst_ctl == CHAN_CTL_ADDR_CTL_FIXED) {
+        to_dev = true;
+        fifo = c->dst;
+        ram = c->src;
+    } else {
+        return 0;
+    }
+    /* Whole elements only */
+    size &= ~(uint64_t)(width - 1);
+    if (!size || !atcdmac300_is_ram(s, ram, !to_dev)) {
+        return 0;
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        mr = address_space_translate(s->as, fifo, &xlat, &fifo_len, to_dev,
+                                     MEMTXATTRS_UNSPECIFIED);
+        owner = memory_region_owner(mr);
+        if (!owner || !object_dynamic_cast(owner, TYPE_ATCDMAC300_PERIPH)) {
+            return 0;
+        }
+        object_ref(owner);
+    }
+
+    ram_len = size;
+    host = address_space_map(s->as, ram, &ram_len, !to_dev,
+                             MEMTXATTRS_UNSPECIFIED);
+    len = 0;
+    if (host) {
+        pc = ATCDMAC300_PERIPH_GET_CLASS(owner);
+        len = pc->burst(ATCDMAC300_PERIPH(owner), xlat, host,
+                        ram_len & ~(uint64_t)(width - 1), to_dev);
+        address_space_unmap(s->as, host, ram_len, !to_dev, len);
+    }
+    object_unref(owner);
+
+    if (to_dev) {
+        c->src += len;
+    } else {
+        c->dst += len;
+    }
+    return len;
+}
+
+static void atcdmac300_addr_step(uint64_t *addr, uint32_t ctl, uint32_t size)
+{
+    if (ctl == CHAN_CTL_ADDR_CTL_INC) {
+        *addr += size;
+    } else if (ctl == CHAN_CTL_ADDR_CTL_DEC) {
+        *addr -= size;
+    }
+}
+
+/*
+ * Copy one source element, writing it to the destination in dst_width
+ * pieces.  Used for fixed/decrementing addresses and for MMIO.
+ */
+static MemTxResult atcdmac300_copy_elem(ATCDMAC300State *s,
+                                        ATCDMAC300Chan *c)
+{
+    uint8_t buf[1 << CHAN_CTL_SRC_WIDTH_MASK];
+    MemTxResult res;
+    uint32_t i, len;
+
+    res = address_space_read(s->as, c->src, MEMTXATTRS_UNSPECIFIED,
+                             buf, c->src_width);
+    atcdmac300_addr_step(&c->src, c->src_ctl, c->src_width);
+    for (i = 0; i < c->src_width; i += len) {
+        len = MIN(c->dst_width, c->src_width - i);
+        res |= address_space_write(s->as, c->dst, MEMTXATTRS_UNSPECIFIED,
+                                   buf + i, len);
+        atcdmac300_addr_step(&c->dst, c->dst_ctl, len);
+    }
+    return res;
+}
+
+static void atcdmac300_chan_irq(ATCDMAC300State *s, int ch, int status)
+{
+    int mask_pos = status == INT_STATUS_TC ? CHAN_CTL_INT_TC_MASK_POS
+                                           : CHAN_CTL_INT_ERR_MASK_POS;
+
+    atcdmac300_dma_int_stat_update(s, status, ch);
+    if (!((s->chan[ch].ChnCtrl >> mask_pos) & 0x1)) {
+        qemu_irq_raise(s->irq);
+    }
+}
+
+static void atcdmac300_chan_complete(ATCDMAC300State *s, int ch, int status)
+{
+    atcdmac300_chan_irq(s, ch, status);
+    atcdmac300_dma_reset_chan(s, ch);
+}
+
+/*
+ * Latch the channel registers into the transfer state.  Returns false if
+ * the programmed transfer is invalid.
+ */
+static bool atcdmac300_chan_latch(ATCDMAC300State *s, int ch)
+{
+    ATCDMAC300Chan *c = &s->chan[ch];
+    uint64_t burst_size;
+
+    c->src_width = 1 << ((c->ChnCtrl >> CHAN_CTL_SRC_WIDTH)
+                         & CHAN_CTL_SRC_WIDTH_MASK);
+    c->dst_width = 1 << ((c->ChnCtrl >> CHAN_CTL_DST_WIDTH)
+                         & CHAN_CTL_DST_WIDTH_MASK);
+    burst_size = 1 << ((c->ChnCtrl >> CHAN_CTL_SRC_BURST_SZ)
+                       & CHAN_CTL_SRC_BURST_SZ_MASK);
+    c->src_ctl = (c->ChnCtrl >> CHAN_CTL_SRC_ADDR_CTL)
+                 & CHAN_CTL_SRC_ADDR_CTL_MASK;
+    c->dst_ctl = (c->ChnCtrl >> CHAN_CTL_DST_ADDR_CTL)
+                 & CHAN_CTL_DST_ADDR_CTL_MASK;
+    c->src = (c->ChnSrcAddrH << 32) | c->ChnSrcAddr;
+    c->dst = (c->ChnDstAddrH << 32) | c->ChnDstAddr;
+    c->remain = (uint64_t)c->ChnTranSize * c->src_width;
+
+    return c->remain && burst_size < (1 << 11) &&
+           c->src_width < (1 << 6) && c->dst_width < (1 << 6) &&
+           (c->src & (c->src_width - 1)) == 0 &&
+           (c->dst & (c->dst_width - 1)) == 0 &&
+           (c->remain & (c->dst_width - 1)) == 0 &&
+           (burst_size * c->src_width & (c->dst_width - 1)) == 0;
+}
+
+/*
+ * Load the next linked-list descriptor into the channel registers.
+ * Returns false if it can't be fetched or describes an invalid transfer.
+ */
+static bool atcdmac300_chan_fetch_desc(ATCDMAC300State *s, int ch)
+{
+    ATCDMAC300Chan *c = &s->chan[ch];
+    ATCDMAC300Desc desc;
+    uint64_t addr = ((uint64_t)c->ChnLLPointerH << 32) |
+                    (c->ChnLLPointer & ~ATCDMAC300_LLP_ATTR_MASK);
+
+    if (dma_memory_read(s->as, addr, &desc, sizeof(desc),
+                        MEMTXATTRS_UNSPECIFIED) != MEMTX_OK) {
+        return false;
+    }
+    c->ChnCtrl = le32_to_cpu(desc.ctrl) | (1 << CHAN_CTL_ENABLE);
+    c->ChnTranSize = le32_to_cpu(desc.tran_size);
+    c->ChnSrcAddr = le32_to_cpu(desc.src_addr);
+    c->ChnSrcAddrH = le32_to_cpu(desc.src_addr_h);
+    c->ChnDstAddr = le32_to_cpu(desc.dst_addr);
+    c->ChnDstAddrH = le32_to_cpu(desc.dst_addr_h);
+    c->ChnLLPointer = le32_to_cpu(desc.ll_pointer);
+    c->ChnLLPointerH = le32_to_cpu(desc.ll_pointer_h);
+    return atcdmac300_chan_latch(s, ch);
+}
+
+/* Move up to budget bytes of a channel, returns the number of bytes moved */
+static uint64_t atcdmac300_chan_run(ATCDMAC300State *s, int ch,
+                                    uint64_t budget)
+{
+    ATCDMAC300Chan *c = &s->chan[ch];
+    MemTxResult res = MEMTX_OK;
+    uint64_t done = 0;
+    uint64_t len;
+
+    while (c->remain && done < budget && res == MEMTX_OK) {
+        len = 0;
+        if (c->src_ctl == CHAN_CTL_ADDR_CTL_INC &&
+            c->dst_ctl == CHAN_CTL_ADDR_CTL_INC) {
+            len = atcdmac300_copy_bulk(s, c, MIN(c->remain, budget - done));
+            c->src += len;
+            c->dst += len;
+        } else {
+            len = atcdmac300_copy_periph(s, c, MIN(c->remain, budget - done));
+        }
+        if (!len) {
+            res = atcdmac300_copy_elem(s, c);
+            len = c->src_width;
+        }
+        c->remain -= len;
+        done += len;
+    }
+
+    LOG("ATCDMAC300: ch[%d]: src=0x%" PRIx64 " dst=0x%" PRIx64
+        " remain=%" PRIu64 "\n", ch, c->src, c->dst, c->remain);
+
+    if (res != MEMTX_OK) {
+        atcdmac300_chan_complete(s, ch, INT_STATUS_ERR);
+    } else if (!c->remain) {
+        if (!c->ChnLLPointer && !c->ChnLLPointerH) {
+            atcdmac300_chan_complete(s, ch, INT_STATUS_TC);
+        } else {
+            /* Each descriptor's own control word decides its interrupts */
+            atcdmac300_chan_irq(s, ch, INT_STATUS_TC);
+            if (!atcdmac300_chan_fetch_desc(s, ch)) {
+                atcdmac300_chan_complete(s, ch, INT_STATUS_ERR);
+            }
+        }
+    }
+    return done;
+}
+
+/*
+ * Share budget bytes between the enabled channels.  High priority
+ * channels are served first; channels of the same priority take turns
+ * moving ATCDMAC300_QUANTUM bytes, starting after the channel served
+ * last.  Returns true if any channel still has data to move.
+ */
+static bool atcdmac300_arbitrate(ATCDMAC300State *s, uint64_t budget)
+{
+    int prio, i, ch;
+    bool active;
+
+    for (prio = 1; prio >= 0; prio--) {
+        do {
+            active = false;
+            for (i = 1; i <= ATCDMAC300_MAX_CHAN && budget; i++) {
+                ch = (s->last_chan + i) % ATCDMAC300_MAX_CHAN;
+                if (!(s->ChEN & (1 << ch)) ||
+                    extract32(s->chan[ch].ChnCtrl, CHAN_CTL_PRIORITY, 1)
+                        != prio) {
+                    continue;
+                }
+                budget -= MIN(budget, atcdmac300_chan_run(s, ch,
+                                  MIN(budget, ATCDMAC300_QUANTUM)));
+                s->last_chan = ch;
+                active = true;
+            }
+        } while (active && budget);
+    }
+    return s->ChEN != 0;
+}
+
+static void atcdmac300_schedule(ATCDMAC300State *s)
+{
+    if (s->bandwidth) {
+        if (!timer_pending(s->timer)) {
+            timer_mod(s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                      ATCDMAC300_TICK_NS);
+        }
+    } else {
+        qemu_bh_schedule(s->bh);
+    }
+}
+
+/*
+ * Without a bandwidth limit, move up to ATCDMAC300_BH_BUDGET bytes per
+ * run and reschedule while data is left so the main loop isn't held up by
+ * large transfers.
+ */
+static void atcdmac300_transfer_bh(void *opaque)
+{
+    ATCDMAC300State *s = opaque;
+
+    if (atcdmac300_arbitrate(s, ATCDMAC300_BH_BUDGET)) {
+        atcdmac300_schedule(s);
+    }
+}
+
+/* With a bandwidth limit, move what the bus can carry in one tick */
+static void atcdmac300_transfer_timer(void *opaque)
+{
+    ATCDMAC300State *s = opaque;
+    uint64_t budget = muldiv64(s->bandwidth, ATCDMAC300_TICK_NS,
+                               NANOSECONDS_PER_SECOND);
+
+    if (atcdmac300_arbitrate(s, MAX(budget, 1))) {
+        atcdmac300_schedule(s);
+    }
+}
+
+/* Latch the channel registers and hand the transfer to the scheduler */
+static void atcdmac300_chan_start(ATCDMAC300State *s, int ch)
+{
+    if (!atcdmac300_chan_latch(s, ch)) {
+        atcdmac300_chan_complete(s, ch, INT_STATUS_ERR);
+        return;
+    }
+
+    LOG("### Start transmit(ch=%d) ###\n", ch);
+    s->ChEN |= 1 << ch;
+    atcdmac300_schedule(s);
+}
+
 static void atcdmac300_write(void *opaque, hwaddr offset, uint64_t value,
                                unsigned size)
 {
     ATCDMAC300State *s = opaque;
     int ch = 0;
-    uint64_t buf[ATCDMAC300_MAX_BURST_SIZE];
-    int64_t remain_size, burst_remain_size, copy_size, copy_size_dst;
-    uint64_t src_addr, dst_addr, src_width, dst_width, burst_size,
-             src_addr_ctl, dst_addr_ctl, int_tc_mask, int_err_mask;
 
     LOG("@@@ atcdmac300_write()=0x%lx, value=0x%lx\n", offset, value);
 
@@ -116,90 +464,7 @@ static void atcdmac300_write(void *opaque, hwaddr offset, uint64_t value,
         s->chan[ch].ChnCtrl = value;
 
         if (((s->chan[ch].ChnCtrl >> CHAN_CTL_ENABLE) & 0x1) == 0x1) {
-            LOG("### Start transmit(ch=%d) ###\n", ch);
-
-            src_width = (s->chan[ch].ChnCtrl >> CHAN_CTL_SRC_WIDTH)
-                            & CHAN_CTL_SRC_WIDTH_MASK;
-            dst_width = (s->chan[ch].ChnCtrl >> CHAN_CTL_DST_WIDTH)
-                            & CHAN_CTL_DST_WIDTH_MASK;
-            burst_size = (s->chan[ch].ChnCtrl >> CHAN_CTL_SRC_BURST_SZ)
-                            & CHAN_CTL_SRC_BURST_SZ_MASK;
-            src_addr = (s->chan[ch].ChnSrcAddrH << 32) | s->chan[ch].ChnSrcAddr;
-            dst_addr = (s->chan[ch].ChnDstAddrH << 32) | s->chan[ch].ChnDstAddr;
-            src_addr_ctl = (s->chan[ch].ChnCtrl >> CHAN_CTL_SRC_ADDR_CTL)
-                            & CHAN_CTL_SRC_ADDR_CTL_MASK;
-            dst_addr_ctl = (s->chan[ch].ChnCtrl >> CHAN_CTL_DST_ADDR_CTL)
-                            & CHAN_CTL_DST_ADDR_CTL_MASK;
-
-            src_width = (1 << src_width);
-            dst_width = (1 << dst_width);
-            burst_size = (1 << burst_size);
-            remain_size = (s->chan[ch].ChnTranSize * src_width);
-            int_tc_mask = (s->chan[ch].ChnCtrl >> CHAN_CTL_INT_TC_MASK_POS)
-                          & 0x1;
-            int_err_mask = (s->chan[ch].ChnCtrl >> CHAN_CTL_INT_ERR_MASK_POS)
-                           & 0x1;
-            if (remain_size && burst_size < (1 << 11) &&
-                src_width < (1 << 6) && dst_width < (1 << 6) &&
-                (src_addr & (src_width - 1)) == 0 &&
-                (dst_addr & (dst_width - 1)) == 0 &&
-                (remain_size & (dst_width - 1)) == 0 &&
-                (burst_size * src_width & (dst_width - 1)) == 0) {
-
-                while (remain_size > 0) {
-                    int i;
-                    for (i = 0; i < burst_size; i++) {
-                        if (remain_size <= 0) {
-                            break;
-                        }
-
-                        memset(buf, 0, sizeof(buf));
-
-                        copy_size = MIN(remain_size, src_width);
-                        cpu_physical_memory_read(src_addr, buf, copy_size);
-                        burst_remain_size = copy_size;
-                        uint64_t *curr_ptr = buf;
-                        while (burst_remain_size > 0) {
-                            copy_size_dst = MIN(burst_remain_size, dst_width);
-                            cpu_physical_memory_write(dst_addr, curr_ptr,
-                                                        copy_size_dst);
-                            curr_ptr += copy_size_dst;
-                            burst_remain_size -= copy_size_dst;
-                        }
-
-                        LOG("ATCDMAC300: ch[%d]: 0x%lx->0x%lx buf=0x%lx,"
-                                " size=%ld\n", ch, src_addr, dst_addr, buf[0]
-                                , copy_size);
-
-                        remain_size -= copy_size;
-
-                        if (src_addr_ctl == 0) {
-                            src_addr += copy_size;
-                        }
-                        if (src_addr_ctl == 1) {
-                            src_addr -= copy_size;
-                        }
-                        if (dst_addr_ctl == 0) {
-                            dst_addr += copy_size;
-                        }
-                        if (dst_addr_ctl == 1) {
-                            dst_addr -= copy_size;
-                        }
-                    }
-                }
-                atcdmac300_dma_reset_chan(s, ch);
-                atcdmac300_dma_int_stat_update(s, INT_STATUS_TC, ch);
-                if (!int_tc_mask) {
-                    qemu_irq_raise(s->irq);
-                }
-            } else {
-                atcdmac300_dma_reset_chan(s, ch);
-                atcdmac300_dma_int_stat_update(s, INT_STATUS_ERR, ch);
-                if (!int_err_mask) {
-                    qemu_irq_raise(s->irq);
-                }
-            }
-
+            atcdmac300_chan_start(s, ch);
         } else {
             atcdmac300_dma_reset_chan(s, ch);
             qemu_irq_lower(s->irq);
@@ -254,6 +519,16 @@ static void atcdmac300_init(Object *obj)
     sysbus_init_mmio(sbus, &s->mmio);
 }
 
+static void atcdmac300_realize(DeviceState *dev, Error **errp)
+{
+    ATCDMAC300State *s = ATCDMAC300(dev);
+
+    s->as = &address_space_memory;
+    s->bh = qemu_bh_new_guarded(atcdmac300_transfer_bh, s,
+                                &dev->mem_reentrancy_guard);
+    s->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, atcdmac300_transfer_timer, s);
+}
+
 static Property atcdmac300_properties[] = {
     DEFINE_PROP_UINT32("mmio-size", ATCDMAC300State, mmio_size, 0x100000),
     DEFINE_PROP_UINT32("id-and-revision", ATCDMAC300State, IdRev,
@@ -263,6 +538,8 @@ static Property atcdmac300_properties[] = {
     DEFINE_PROP_UINT32("inturrupt-status", ATCDMAC300State, IntStatus, 0),
     DEFINE_PROP_UINT32("dmac-configuration", ATCDMAC300State,
                             DMACfg, 0xc3404108),
+    /* Bytes per second shared by all channels, 0 for unlimited */
+    DEFINE_PROP_UINT64("bandwidth", ATCDMAC300State, bandwidth, 0),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -270,8 +547,15 @@ static void atcdmac300_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *k = DEVICE_CLASS(klass);
     device_class_set_props(k, atcdmac300_properties);
+    k->realize = atcdmac300_realize;
 }
 
+static const TypeInfo atcdmac300_periph_info = {
+    .name          = TYPE_ATCDMAC300_PERIPH,
+    .parent        = TYPE_INTERFACE,
+    .class_size    = sizeof(ATCDMAC300PeriphClass),
+};
+
 static const TypeInfo atcdmac300_info = {
     .name          = TYPE_ATCDMAC300,
     .parent        = TYPE_SYS_BUS_DEVICE,
@@ -295,6 +579,7 @@ atcdmac300_create(ATCDMAC300State *atcdmac, const char *name,
 static void atcdmac300_register_types(void)
 {
     type_register_static(&atcdmac300_info);
+    type_register_static(&atcdmac300_periph_info);
 }
 
 type_init(atcdmac300_register_types)
@@ -19,6 +19,7 @@
 #include "qemu/osdep.h"
 #include "qemu/error-report.h"
 #include "qemu/log.h"
+#include "qemu/bitmap.h"
 #include "qapi/error.h"
 #include "hw/qdev-properties.h"
 #include "target/riscv/cpu.h"
@@ -69,6 +70,76 @@ static void andes_plic_set_gw_state(AndesPLICState *plic, int irq, bool level)
     atomic_set_masked(&plic->gw_state[irq >> 5], 1 << (irq & 31), -!!level);
 }
 
+static void andes_plichw_update_target(AndesPLICState *andes_plic,
+                                       uint32_t target_id)
+{
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t hartid = riscv_plic->addr_config[target_id].hartid;
+    PLICMode mode = riscv_plic->addr_config[target_id].mode;
+    CPUState *cpu = andes_plic->target_cpu[target_id];
+
+    if (!cpu) {
+        return;
+    }
+
+    CPURISCVState *env = cpu_env(cpu);
+    int level = riscv_plic_irqs_pending(riscv_plic, target_id);
+    AndesCsr *csr = &env->andes_csr;
+    AndesVec *vec = &env->andes_vec;
+    switch (mode) {
+    case PlicMode_M:
+        if (!vec->vectored_irq_m &&
+            (csr->csrno[CSR_MMISC_CTL] & (1UL << V5_MMISC_CTL_VEC_PLIC)) &&
+            (andes_plic->feature_enable & FER_VECTORED) && level) {
+                vec->vectored_irq_m =
+                    riscv_plic->riscv_plic_claim(riscv_plic, target_id);
+                assert(vec->vectored_irq_m);
+        }
+        qemu_set_irq(riscv_plic->m_external_irqs[hartid -
+                     riscv_plic->hartid_base], level);
+        break;
+    case PlicMode_S:
+        if (!vec->vectored_irq_s &&
+            (csr->csrno[CSR_MMISC_CTL] & (1UL << V5_MMISC_CTL_VEC_PLIC)) &&
+            (andes_plic->feature_enable & FER_VECTORED) && level) {
+                vec->vectored_irq_s =
+                    riscv_plic->riscv_plic_claim(riscv_plic, target_id);
+                assert(vec->vectored_irq_s);
+        }
+        qemu_set_irq(riscv_plic->s_external_irqs[hartid -
+                     riscv_plic->hartid_base], level);
+        break;
+    default:
+        break;
+    }
+}
+
+static void andes_plicsw_update_target(AndesPLICState *andes_plic,
+                                       uint32_t target_id)
+{
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t hartid = riscv_plic->addr_config[target_id].hartid;
+    PLICMode mode = riscv_plic->addr_config[target_id].mode;
+
+    if (!andes_plic->target_cpu[target_id]) {
+        return;
+    }
+
+    int level = riscv_plic_irqs_pending(riscv_plic, target_id);
+    switch (mode) {
+    case PlicMode_M:
+        qemu_set_irq(riscv_plic->m_external_irqs[hartid -
+                     riscv_plic->hartid_base], level);
+        break;
+    case PlicMode_S:
+        qemu_set_irq(riscv_plic->s_external_irqs[hartid -
+                     riscv_plic->hartid_base], level);
+        break;
+    default:
+        break;
+    }
+}
+
 void andes_plichw_update(void *plic)
 {
     AndesPLICState *andes_plic = ANDES_PLIC(plic);
@@ -77,43 +148,7 @@ void andes_plichw_update(void *plic)
 
     /* raise irq on harts where this irq is enabled */
     for (target_id = 0; target_id < riscv_plic->num_addrs; target_id++) {
-        uint32_t hartid = riscv_plic->addr_config[target_id].hartid;
-        PLICMode mode = riscv_plic->addr_config[target_id].mode;
-        CPUState *cpu = qemu_get_cpu(hartid);
-        CPURISCVState *env = cpu_env(cpu);
-        if (!env) {
-            continue;
-        }
-        int level = riscv_plic_irqs_pending(riscv_plic, target_id);
-
-        AndesCsr *csr = &env->andes_csr;
-        AndesVec *vec = &env->andes_vec;
-        switch (mode) {
-        case PlicMode_M:
-            if (!vec->vectored_irq_m &&
-                (csr->csrno[CSR_MMISC_CTL] & (1UL << V5_MMISC_CTL_VEC_PLIC)) &&
-                (andes_plic->feature_enable & FER_VECTORED) && level) {
-                    vec->vectored_irq_m =
-                        riscv_plic->riscv_plic_claim(riscv_plic, target_id);
-                    assert(vec->vectored_irq_m);
-            }
-            qemu_set_irq(riscv_plic->m_external_irqs[hartid -
-                         riscv_plic->hartid_base], level);
-            break;
-        case PlicMode_S:
-            if (!vec->vectored_irq_s &&
-                (csr->csrno[CSR_MMISC_CTL] & (1UL << V5_MMISC_CTL_VEC_PLIC)) &&
-                (andes_plic->feature_enable & FER_VECTORED) && level) {
-                    vec->vectored_irq_s =
-                        riscv_plic->riscv_plic_claim(riscv_plic, target_id);
-                    assert(vec->vectored_irq_s);
-            }
-            qemu_set_irq(riscv_plic->s_external_irqs[hartid -
-                         riscv_plic->hartid_base], level);
-            break;
-        default:
-            break;
-        }
+        andes_plichw_update_target(andes_plic, target_id);
     }
 }
 
@@ -125,28 +160,128 @@ void andes_plicsw_update(void *plic)
 
     /* raise irq on harts where this irq is enabled */
     for (target_id = 0; target_id < riscv_plic->num_addrs; target_id++) {
-        uint32_t hartid = riscv_plic->addr_config[target_id].hartid;
-        PLICMode mode = riscv_plic->addr_config[target_id].mode;
-        CPUState *cpu = qemu_get_cpu(hartid);
-        CPURISCVState *env = cpu_env(cpu);
-        if (!env) {
-            continue;
+        andes_plicsw_update_target(andes_plic, target_id);
+    }
+}
+
+static unsigned long *andes_plic_source_targets(AndesPLICState *andes_plic,
+                                                uint32_t irq)
+{
+    return &andes_plic->source_targets[irq * andes_plic->target_longs];
+}
+
+/*
+ * Only the targets that can take irq see a change of its pending or
+ * claimed state, so only they need to be re-evaluated
+ */
+static void andes_plic_update_source(AndesPLICState *andes_plic, uint32_t irq)
+{
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    unsigned long *targets = andes_plic_source_targets(andes_plic, irq);
+    unsigned long target_id;
+
+    for (target_id = find_first_bit(targets, riscv_plic->num_addrs);
+         target_id < riscv_plic->num_addrs;
+         target_id = find_next_bit(targets, riscv_plic->num_addrs,
+                                   target_id + 1)) {
+        andes_plic->andes_plic_update_target(andes_plic, target_id);
+    }
+}
+
+/* Recompute the targets of irq from the enables and its priority */
+static void andes_plic_rebuild_source_targets(AndesPLICState *andes_plic,
+                                              uint32_t irq)
+{
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    unsigned long *targets = andes_plic_source_targets(andes_plic, irq);
+    uint32_t target_id;
+
+    bitmap_zero(targets, riscv_plic->num_addrs);
+    if (!riscv_plic->source_priority[irq]) {
+        return;
+    }
+    for (target_id = 0; target_id < riscv_plic->num_addrs; target_id++) {
+        if (riscv_plic->enable[target_id * riscv_plic->bitfield_words +
+                               (irq >> 5)] & (1u << (irq & 31))) {
+            set_bit(target_id, targets);
         }
-        int level = riscv_plic_irqs_pending(riscv_plic, target_id);
+    }
+}
 
-        switch (mode) {
-        case PlicMode_M:
-            qemu_set_irq(riscv_plic->m_external_irqs[hartid -
-                         riscv_plic->hartid_base], level);
-            break;
-        case PlicMode_S:
-            qemu_set_irq(riscv_plic->s_external_irqs[hartid -
-                         riscv_plic->hartid_base], level);
-            break;
-        default:
+static void andes_plic_write_priority(void *opaque,
+        hwaddr addr, uint64_t value, unsigned size)
+{
+    AndesPLICState *andes_plic = ANDES_PLIC(opaque);
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t irq = ((addr - riscv_plic->priority_base) >> 2) + 1;
+
+    andes_plic->parent_write_priority(opaque, addr, value, size);
+    if (irq < riscv_plic->num_sources) {
+        andes_plic_rebuild_source_targets(andes_plic, irq);
+    }
+}
+
+/* source_targets is not migrated, so rebuild it from the loaded state */
+static int andes_plic_post_load(void *opaque, int version_id)
+{
+    AndesPLICState *andes_plic = ANDES_PLIC(opaque);
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t irq;
+
+    for (irq = 1; irq < riscv_plic->num_sources; irq++) {
+        andes_plic_rebuild_source_targets(andes_plic, irq);
+    }
+    return 0;
+}
+
+static void andes_plic_write_enable(void *opaque,
+        hwaddr addr, uint64_t value, unsigned size)
+{
+    AndesPLICState *andes_plic = ANDES_PLIC(opaque);
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t addrid = (addr - riscv_plic->enable_base) /
+                      riscv_plic->enable_stride;
+    uint32_t wordid = (addr & (riscv_plic->enable_stride - 1)) >> 2;
+    uint32_t enable, irq;
+    int j;
+
+    andes_plic->parent_write_enable(opaque, addr, value, size);
+    if (wordid >= riscv_plic->bitfield_words) {
+        return;
+    }
+
+    enable = riscv_plic->enable[addrid * riscv_plic->bitfield_words + wordid];
+    for (j = 0; j < 32; j++) {
+        irq = (wordid << 5) + j;
+        if (irq >= riscv_plic->num_sources) {
             break;
         }
+        if ((enable & (1u << j)) && riscv_plic->source_priority[irq]) {
+            set_bit(addrid, andes_plic_source_targets(andes_plic, irq));
+        } else {
+            clear_bit(addrid, andes_plic_source_targets(andes_plic, irq));
+        }
+    }
+}
+
+static uint64_t andes_plic_read_claim(void *opaque,
+        hwaddr addr, unsigned size)
+{
+    AndesPLICState *andes_plic = ANDES_PLIC(opaque);
+    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
+    uint32_t addrid =
+        (addr - riscv_plic->context_base) / riscv_plic->context_stride;
+    uint32_t value = riscv_plic->riscv_plic_claim(riscv_plic, addrid);
+
+    LOG("andes_plic: read claim: hart%d-%d irq=%x\n",
+        riscv_plic->addr_config[addrid].hartid,
+        riscv_plic->addr_config[addrid].mode, value);
+    if (value) {
+        andes_plic_update_source(andes_plic, value);
+    } else {
+        andes_plic->andes_plic_update_target(andes_plic, addrid);
     }
+    return value;
 }
 
 static void andes_plic_write_pending(void *plic,
@@ -201,7 +336,7 @@ static void andes_plic_write_complete(void *opaque,
         andes_plic_set_claimed(andes_plic, value, false);
         /* Reset Interrupt Gateway State to non in-process */
         andes_plic_set_gw_state(andes_plic, value, false);
-        riscv_plic->riscv_plic_update(riscv_plic);
+        andes_plic_update_source(andes_plic, value);
     }
 }
 
@@ -298,7 +433,6 @@ andes_plic_write(void *opaque, hwaddr addr, uint64_t value, unsigned size)
 static void andes_plic_irq_request(void *opaque, int irq, int level)
 {
     AndesPLICState *andes_plic = ANDES_PLIC(opaque);
-    RISCVPLICState *riscv_plic = RISCV_PLIC(andes_plic);
 
     uint32_t gw_state =
         qatomic_read(&andes_plic->gw_state[irq >> 5]) & 1 << (irq & 31);
@@ -318,7 +452,7 @@ static void andes_plic_irq_request(void *opaque, int irq, int level)
          * to avoid interrupt missing for handling
          */
         if (level) {
-            riscv_plic->riscv_plic_update(riscv_plic);
+            andes_plic_update_source(andes_plic, irq);
         }
         return;
     }
@@ -329,7 +463,7 @@ static void andes_plic_irq_request(void *opaque, int irq, int level)
     }
 
     andes_plic_set_pending(andes_plic, irq, level > 0);
-    riscv_plic->riscv_plic_update(riscv_plic);
+    andes_plic_update_source(andes_plic, irq);
 }
 
 static const MemoryRegionOps andes_plic_ops = {
@@ -364,10 +498,21 @@ andes_plic_realize(DeviceState *dev, Error **errp)
     /* Allocate trigger type register space */
     andes_plic->trigger_type = g_new0(uint32_t, riscv_plic->bitfield_words);
 
+    andes_plic->target_longs = BITS_TO_LONGS(riscv_plic->num_addrs);
+    andes_plic->source_targets = g_new0(unsigned long,
+        riscv_plic->num_sources * andes_plic->target_longs);
+    andes_plic->target_cpu = g_new0(CPUState *, riscv_plic->num_addrs);
+    for (int i = 0; i < riscv_plic->num_addrs; i++) {
+        andes_plic->target_cpu[i] =
+            qemu_get_cpu(riscv_plic->addr_config[i].hartid);
+    }
+
     if (strstr(andes_plic->plic_name , "SW") != NULL) {
         riscv_plic->riscv_plic_update = andes_plicsw_update;
+        andes_plic->andes_plic_update_target = andes_plicsw_update_target;
     } else {
         riscv_plic->riscv_plic_update = andes_plichw_update;
+        andes_plic->andes_plic_update_target = andes_plichw_update_target;
     }
     /*
      * Let Andes PLIC and SWPLIC to disable IO re-entrant checking,
@@ -377,6 +522,12 @@ andes_plic_realize(DeviceState *dev, Error **errp)
     riscv_plic->mmio.disable_reentrancy_guard = true;
     riscv_plic->riscv_plic_write_pending = andes_plic_write_pending;
     riscv_plic->riscv_plic_write_complete = andes_plic_write_complete;
+    riscv_plic->riscv_plic_read_claim = andes_plic_read_claim;
+    andes_plic->parent_write_priority = riscv_plic->riscv_plic_write_priority;
+    riscv_plic->riscv_plic_write_priority = andes_plic_write_priority;
+    andes_plic->parent_write_enable = riscv_plic->riscv_plic_write_enable;
+    riscv_plic->riscv_plic_write_enable = andes_plic_write_enable;
+    riscv_plic->riscv_plic_post_load = andes_plic_post_load;
     /* register andes irq request function to process irq request */
     riscv_plic->riscv_plic_irq_request = andes_plic_irq_request;
 
@@ -404,6 +555,10 @@ static void andes_plic_reset(DeviceState *dev)
            riscv_plic->bitfield_words);
     memset(andes_plic->gw_state, 0, sizeof(uint32_t) *
            riscv_plic->bitfield_words);
+    /* Enables and priorities are cleared, so no source has targets */
+    bitmap_zero(andes_plic->source_targets,
+                riscv_plic->num_sources * andes_plic->target_longs *
+                BITS_PER_LONG);
     /* No reset trigger type */
 }
 
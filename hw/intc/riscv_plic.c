@@ -606,10 +606,21 @@ static void riscv_plic_realize(DeviceState *dev, Error **errp)
     msi_nonbroken = true;
 }
 
+static int riscv_plic_post_load(void *opaque, int version_id)
+{
+    RISCVPLICState *plic = opaque;
+
+    if (plic->riscv_plic_post_load) {
+        return plic->riscv_plic_post_load(plic, version_id);
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_riscv_plic = {
     .name = "riscv_plic",
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = riscv_plic_post_load,
     .fields = (VMStateField[]) {
             VMSTATE_VARRAY_UINT32(source_priority, RISCVPLICState,
                                   num_sources, 0,
@@ -13,6 +13,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/log.h"
+#include "qemu/timer.h"
 #include "qapi/error.h"
 #include "sysemu/dma.h"
 #include "net/net.h"
@@ -188,14 +189,6 @@ enum {
 #define PHY_INT_DOWN                (1 << 8)
 #define PHY_INT_JABBER              (1 << 0)
 
-/* RX & TX Descriptor */
-typedef struct {
-    uint32_t des0;
-    uint32_t des1;
-    uint32_t des2;
-    uint32_t des3;
-} ATFMAC100Desc;
-
 static inline int
 atfmac100_max_frame_size(void)
 {
@@ -386,40 +379,58 @@ atfmac100_read_desc(ATFMAC100Desc *desc, dma_addr_t addr)
     return 0;
 }
 
-static int
-atfmac100_write_desc(ATFMAC100Desc *desc, dma_addr_t addr)
+static void
+atfmac100_tx_unmap(struct iovec *iov, dma_addr_t *map_len, int iovcnt)
 {
     int i;
-    uint32_t *ptr;
-
-    LOG("%s: %08x - %08x %08x %08x %08x\n", __func__,
-        (int)addr, desc->des0, desc->des1, desc->des2, desc->des3);
 
-    ptr = (uint32_t *)desc;
-    for (i = 0; i < 4; ++i) {
-        ptr[i] = cpu_to_le32(ptr[i]);
+    for (i = 0; i < iovcnt; i++) {
+        if (map_len[i]) {
+            dma_memory_unmap(&address_space_memory, iov[i].iov_base,
+                             map_len[i], DMA_DIRECTION_TO_DEVICE,
+                             iov[i].iov_len);
+        }
     }
+}
 
-    if (dma_memory_write(&address_space_memory, addr, desc,
-                            sizeof(*desc), MEMTXATTRS_UNSPECIFIED)) {
-        qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to write descriptor @ 0x%"
-                      HWADDR_PRIx "\n", __func__, addr);
-        return -1;
+static void
+atfmac100_do_tx(ATFMAC100State *s, uint32_t tx_ring_base,
+                uint32_t tx_desc_addr);
+
+static void
+atfmac100_tx_sent(NetClientState *nc, ssize_t len)
+{
+    ATFMAC100State *s = ATFMAC100(qemu_get_nic_opaque(nc));
+    uint32_t mask = MACCR_XDMA_EN | MACCR_XMT_EN;
+
+    s->tx_blocked = false;
+    if ((s->maccr & mask) == mask) {
+        atfmac100_do_tx(s, s->txr_badr, s->tx_desc_addr);
     }
-    return 0;
 }
 
+/*
+ * Drain the TX ring.  Buffers are gathered straight from guest memory into
+ * an iovec; only buffers that can't be mapped, or fragments beyond
+ * ATFMAC100_TX_MAX_FRAGS, are copied through s->frame.  If the peer can't
+ * take more packets the ring is left where it is until atfmac100_tx_sent.
+ */
 static void
 atfmac100_do_tx(ATFMAC100State *s, uint32_t tx_ring_base, uint32_t tx_desc_addr)
 {
+    struct iovec iov[ATFMAC100_TX_MAX_FRAGS];
+    dma_addr_t map_len[ATFMAC100_TX_MAX_FRAGS];
+    int iovcnt = 0;
     int frame_size = 0;
-    uint8_t *ptr = s->frame;
+    int bounce_size = 0;
     uint32_t addr = tx_desc_addr;
     uint32_t flags = 0;
     int max_frame_size = atfmac100_max_frame_size();
 
-    while (1) {
+    while (!s->tx_blocked) {
         ATFMAC100Desc desc;
+        dma_addr_t mlen;
+        void *host = NULL;
         int len;
 
         if (atfmac100_read_desc(&desc, addr) ||
@@ -442,21 +453,57 @@ atfmac100_do_tx(ATFMAC100State *s, uint32_t tx_ring_base, uint32_t tx_desc_addr)
             len = max_frame_size - frame_size;
         }
 
-        if (dma_memory_read(&address_space_memory, desc.des2, ptr, len,
-                            MEMTXATTRS_UNSPECIFIED)) {
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to read packet @ 0x%x\n",
-                          __func__, desc.des2);
-            s->isr |= INT_NOTXBUF;
-            break;
+        if (len && iovcnt < ATFMAC100_TX_MAX_FRAGS - 1) {
+            mlen = len;
+            host = dma_memory_map(&address_space_memory, desc.des2, &mlen,
+                                  DMA_DIRECTION_TO_DEVICE,
+                                  MEMTXATTRS_UNSPECIFIED);
+            if (host && mlen != len) {
+                dma_memory_unmap(&address_space_memory, host, mlen,
+                                 DMA_DIRECTION_TO_DEVICE, 0);
+                host = NULL;
+            }
+        }
+        if (host) {
+            iov[iovcnt].iov_base = host;
+            iov[iovcnt].iov_len = len;
+            map_len[iovcnt++] = len;
+        } else if (len) {
+            uint8_t *ptr = s->frame + bounce_size;
+
+            if (dma_memory_read(&address_space_memory, desc.des2, ptr, len,
+                                MEMTXATTRS_UNSPECIFIED)) {
+                qemu_log_mask(LOG_GUEST_ERROR,
+                              "%s: failed to read packet @ 0x%x\n",
+                              __func__, desc.des2);
+                s->isr |= INT_NOTXBUF;
+                break;
+            }
+            /* Extend the previous fragment if it is the bounce tail */
+            if (iovcnt && !map_len[iovcnt - 1] &&
+                (uint8_t *)iov[iovcnt - 1].iov_base +
+                    iov[iovcnt - 1].iov_len == ptr) {
+                iov[iovcnt - 1].iov_len += len;
+            } else {
+                iov[iovcnt].iov_base = ptr;
+                iov[iovcnt].iov_len = len;
+                map_len[iovcnt++] = 0;
+            }
+            bounce_size += len;
         }
 
-        ptr += len;
         frame_size += len;
         if (desc.des1 & TXDES1_LTS) {
             /* Last buffer in frame.  */
-            qemu_send_packet(qemu_get_queue(s->nic), s->frame, frame_size);
-            ptr = s->frame;
+            if (!qemu_sendv_packet_async(qemu_get_queue(s->nic), iov, iovcnt,
+                                         atfmac100_tx_sent)) {
+                /* Queued (and copied) by the net layer, wait for it */
+                s->tx_blocked = true;
+            }
+            atfmac100_tx_unmap(iov, map_len, iovcnt);
+            iovcnt = 0;
             frame_size = 0;
+            bounce_size = 0;
             LOG("%s: LTS\n", __func__);
             if (flags & TXDES1_TXIC) {
                 s->isr |= INT_XPKT_OK;
@@ -466,9 +513,11 @@ atfmac100_do_tx(ATFMAC100State *s, uint32_t tx_ring_base, uint32_t tx_desc_addr)
         if (flags & TXDES1_TX2FIC) {
             s->isr |= INT_XPKT_FINISH;
         }
-        desc.des0 &= ~TXDES0_TXDMA_OWN;
 
-        atfmac100_write_desc(&desc, addr);
+        /* Only the ownership bit changes, don't write back the rest */
+        desc.des0 &= ~TXDES0_TXDMA_OWN;
+        stl_le_dma(&address_space_memory, addr, desc.des0,
+                   MEMTXATTRS_UNSPECIFIED);
         /* Advance to the next descriptor.  */
         if (desc.des1 & TXDES1_EDOTR) {
             addr = tx_ring_base;
@@ -477,11 +526,67 @@ atfmac100_do_tx(ATFMAC100State *s, uint32_t tx_ring_base, uint32_t tx_desc_addr)
         }
     }
 
+    /* Drop a frame whose last buffer isn't owned by the device yet */
+    atfmac100_tx_unmap(iov, map_len, iovcnt);
     s->tx_desc_addr = addr;
 
     atfmac100_update_irq(s);
 }
 
+/*
+ * Completed RX descriptors are written back in batches: consecutive
+ * descriptors in the ring go out with one DMA write.
+ */
+static void
+atfmac100_rx_wb_flush(ATFMAC100State *s)
+{
+    uint32_t *ptr = (uint32_t *)s->rx_wb;
+    int i;
+
+    if (!s->rx_wb_count) {
+        return;
+    }
+    for (i = 0; i < s->rx_wb_count * 4; i++) {
+        ptr[i] = cpu_to_le32(ptr[i]);
+    }
+    if (dma_memory_write(&address_space_memory, s->rx_wb_addr, s->rx_wb,
+                         s->rx_wb_count * sizeof(ATFMAC100Desc),
+                         MEMTXATTRS_UNSPECIFIED)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to write descriptors @ 0x%"
+                      PRIx32 "\n", __func__, s->rx_wb_addr);
+    }
+    s->rx_wb_count = 0;
+}
+
+static void
+atfmac100_rx_wb_add(ATFMAC100State *s, ATFMAC100Desc *desc, uint32_t addr)
+{
+    if (s->rx_wb_count == ATFMAC100_RX_BATCH_MAX ||
+        (s->rx_wb_count && addr != s->rx_wb_addr +
+                                   s->rx_wb_count * sizeof(ATFMAC100Desc))) {
+        atfmac100_rx_wb_flush(s);
+    }
+    if (!s->rx_wb_count) {
+        s->rx_wb_addr = addr;
+    }
+    s->rx_wb[s->rx_wb_count++] = *desc;
+}
+
+/*
+ * Read the RX descriptor at @addr.  If its write-back is still pending,
+ * as when the ring wraps onto the run of descriptors completed so far,
+ * flush the run first so that the guest memory reflects their OWN bits.
+ */
+static int
+atfmac100_rx_read_desc(ATFMAC100State *s, ATFMAC100Desc *desc, uint32_t addr)
+{
+    if (s->rx_wb_count && addr >= s->rx_wb_addr &&
+        addr < s->rx_wb_addr + s->rx_wb_count * sizeof(ATFMAC100Desc)) {
+        atfmac100_rx_wb_flush(s);
+    }
+    return atfmac100_read_desc(desc, addr);
+}
+
 static bool
 atfmac100_can_receive(NetClientState *nc)
 {
@@ -493,7 +598,7 @@ atfmac100_can_receive(NetClientState *nc)
         return 0;
     }
 
-    if (atfmac100_read_desc(&desc, s->rx_desc_addr)) {
+    if (atfmac100_rx_read_desc(s, &desc, s->rx_desc_addr)) {
         return 0;
     }
 
@@ -579,6 +684,11 @@ atfmac100_reset(DeviceState *dev)
     s->rpcnt = 0;
     s->xpcnt = 0;
 
+    s->tx_blocked = false;
+    s->rx_wb_count = 0;
+    s->rx_pending_frames = 0;
+    timer_del(s->rx_coalesce_timer);
+
     phy_reset(s);
 }
 
@@ -937,6 +1047,25 @@ atfmac100_filter(ATFMAC100State *s, const uint8_t *buf, size_t len)
     return 1;
 }
 
+/* Hand the received frames to the guest and raise the interrupt */
+static void
+atfmac100_rx_complete(ATFMAC100State *s)
+{
+    atfmac100_rx_wb_flush(s);
+    if (s->rx_pending_frames) {
+        s->isr |= INT_RPKT_FINISH;
+        s->rx_pending_frames = 0;
+    }
+    timer_del(s->rx_coalesce_timer);
+    atfmac100_update_irq(s);
+}
+
+static void
+atfmac100_rx_coalesce_timer(void *opaque)
+{
+    atfmac100_rx_complete(opaque);
+}
+
 /* TODO: refine CRC data handling */
 static ssize_t
 atfmac100_receive(NetClientState *nc, const uint8_t *buf, size_t len)
@@ -1004,12 +1133,13 @@ atfmac100_receive(NetClientState *nc, const uint8_t *buf, size_t len)
 
     addr = s->rx_desc_addr;
     while (size > 0) {
-        if (!atfmac100_can_receive(nc)) {
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: Unexpected packet\n", __func__);
-            return -1;
-        }
-
-        if (atfmac100_read_desc(&bd, addr) || !(bd.des0 & RXDES0_RXDMA_OWN)) {
+        if (atfmac100_rx_read_desc(s, &bd, addr) ||
+            !(bd.des0 & RXDES0_RXDMA_OWN)) {
+            if (first) {
+                qemu_log_mask(LOG_GUEST_ERROR, "%s: Unexpected packet\n",
+                              __func__);
+                return -1;
+            }
             /* No descriptors available.  Bail out.  */
             qemu_log_mask(LOG_GUEST_ERROR, "%s: Lost end of frame\n",
                           __func__);
@@ -1042,11 +1172,11 @@ atfmac100_receive(NetClientState *nc, const uint8_t *buf, size_t len)
         if (size == 0) {
             /* Last buffer in frame.  */
             bd.des0 |= flags | RXDES0_LRS;
-            s->isr |= INT_RPKT_FINISH;
+            s->rx_pending_frames++;
         } else {
             s->isr |= INT_RPKT_SAV;
         }
-        atfmac100_write_desc(&bd, addr);
+        atfmac100_rx_wb_add(s, &bd, addr);
         /* next RX descriptor */
         if (bd.des1 & RXDES1_EDORR) {
             addr = s->rxr_badr;
@@ -1056,7 +1186,17 @@ atfmac100_receive(NetClientState *nc, const uint8_t *buf, size_t len)
     }
     s->rx_desc_addr = addr;
 
-    atfmac100_update_irq(s);
+    if (s->isr & INT_NORXBUF ||
+        s->rx_pending_frames >= s->rx_coalesce_frames) {
+        atfmac100_rx_complete(s);
+    } else {
+        if (!timer_pending(s->rx_coalesce_timer)) {
+            timer_mod(s->rx_coalesce_timer,
+                      qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                      s->rx_coalesce_usecs * SCALE_US);
+        }
+        atfmac100_update_irq(s);
+    }
     return len;
 }
 
@@ -1094,6 +1234,13 @@ static void atfmac100_realize(DeviceState *dev, Error **errp)
     sysbus_init_mmio(sbd, &s->mmio);
     sysbus_init_irq(sbd, &s->irq);
 
+    if (!s->rx_coalesce_frames) {
+        error_setg(errp, "rx-coalesce-frames must be at least 1");
+        return;
+    }
+    s->rx_coalesce_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+                                        atfmac100_rx_coalesce_timer, s);
+
     qemu_macaddr_default_if_unset(&s->conf.macaddr);
     s->conf.peers.ncs[0] = nd_table[0].netdev;
     s->nic = qemu_new_nic(&net_atfmac100_info, &s->conf,
@@ -1117,6 +1264,11 @@ static Property atfmac100_properties[] = {
     DEFINE_NIC_PROPERTIES(ATFMAC100State, conf),
     DEFINE_PROP_UINT32("revision", ATFMAC100State, revision,
                        ATFMAC100_MODID_VALUE),
+    /* RX interrupt after this many frames, or rx-coalesce-usecs */
+    DEFINE_PROP_UINT32("rx-coalesce-frames", ATFMAC100State,
+                       rx_coalesce_frames, 1),
+    DEFINE_PROP_UINT32("rx-coalesce-usecs", ATFMAC100State,
+                       rx_coalesce_usecs, 100),
     DEFINE_PROP_END_OF_LIST(),
 };
 
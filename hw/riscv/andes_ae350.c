@@ -543,45 +543,18 @@ static int andes_load_elf(MachineState *machine,
     return 0;
 }
 
-typedef struct Slaveport_status {
-    int hart_id;
-    bool dlm;
-} Slaveport_status;
+/*
+ * The slave port window of a hart without that local memory, and the part
+ * of the window past the end of it, reads as zero and ignores writes.
+ */
 static uint64_t slaveport_read(void *opaque, hwaddr addr, unsigned size)
 {
-    uint64_t ret = 0;
-    Slaveport_status *s = (Slaveport_status *)opaque;
-    CPUState *cs = qemu_get_cpu(s->hart_id);
-    if (!cs) {
-        return ret;
-    }
-    CPURISCVState *env = &RISCV_CPU(cs)->env;
-    if (s->dlm) {
-        memory_region_dispatch_read(env->mask_dlm, addr, &ret,
-            size_memop(size) | MO_LE, (MemTxAttrs) { .memory = 1 });
-    } else {
-        memory_region_dispatch_read(env->mask_ilm, addr, &ret,
-            size_memop(size) | MO_LE, (MemTxAttrs) { .memory = 1 });
-    }
-    return ret;
+    return 0;
 }
 
 static void slaveport_write(void *opaque, hwaddr addr, uint64_t value,
                             unsigned size)
 {
-    Slaveport_status *s = (Slaveport_status *)opaque;
-    CPUState *cs = qemu_get_cpu(s->hart_id);
-    if (!cs) {
-        return;
-    }
-    CPURISCVState *env = &RISCV_CPU(cs)->env;
-    if (s->dlm) {
-        memory_region_dispatch_write(env->mask_dlm, addr, value,
-            size_memop(size) | MO_LE, (MemTxAttrs) { .memory = 1 });
-    } else {
-        memory_region_dispatch_write(env->mask_ilm, addr, value,
-            size_memop(size) | MO_LE, (MemTxAttrs) { .memory = 1 });
-    }
 }
 
 static const MemoryRegionOps slaveport_ops = {
@@ -600,13 +573,17 @@ static const MemoryRegionOps slaveport_ops = {
     },
 };
 
+/*
+ * Map the ILM or DLM of a hart into the system address space as an alias
+ * of its RAM, so other masters reach it like any other RAM: directly from
+ * the TLB, and with the dirty tracking that invalidates the TBs of code
+ * they overwrite.
+ */
 static void slaveport_create(int hart_id, bool dlm, hwaddr base, hwaddr size)
 {
-    Slaveport_status *s = g_new(Slaveport_status, 1);
-    s->hart_id = hart_id;
-    s->dlm = dlm;
     MemoryRegion *slaveport_mr = g_new(MemoryRegion, 1);
     MemoryRegion *system_memory = get_system_memory();
+    CPUState *cs = qemu_get_cpu(hart_id);
     char *name;
     if (dlm) {
         name = g_strdup_printf("%s%d_%s", "riscv.andes.ae350.slaveport",
@@ -615,9 +592,28 @@ static void slaveport_create(int hart_id, bool dlm, hwaddr base, hwaddr size)
         name = g_strdup_printf("%s%d_%s", "riscv.andes.ae350.slaveport",
                                hart_id, "ilm");
     }
-    memory_region_init_io(slaveport_mr, NULL, &slaveport_ops, s,
+    memory_region_init_io(slaveport_mr, NULL, &slaveport_ops, NULL,
                           name, size);
     memory_region_add_subregion(system_memory, base, slaveport_mr);
+    g_free(name);
+
+    if (cs) {
+        CPURISCVState *env = &RISCV_CPU(cs)->env;
+        MemoryRegion *lm = dlm ? env->mask_dlm : env->mask_ilm;
+        uint32_t lm_size = dlm ? env->dlm_size : env->ilm_size;
+        MemoryRegion *alias;
+
+        if (!lm_size) {
+            return;
+        }
+        alias = g_new(MemoryRegion, 1);
+        name = g_strdup_printf("%s%d_%s", "riscv.andes.ae350.slaveport",
+                               hart_id, dlm ? "dlm.ram" : "ilm.ram");
+        memory_region_init_alias(alias, NULL, name, lm, 0,
+                                 MIN(size, lm_size));
+        memory_region_add_subregion_overlap(slaveport_mr, 0, alias, 1);
+        g_free(name);
+    }
 }
 
 static void andes_ae350_machine_init(MachineState *machine)
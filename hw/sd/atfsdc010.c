@@ -10,6 +10,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/log.h"
+#include "qemu/main-loop.h"
 #include "qapi/error.h"
 #include "sysemu/block-backend.h"
 #include "sysemu/blockdev.h"
@@ -20,6 +21,7 @@
 #include "hw/sd/sd.h"
 #include "hw/sd/sdcard_legacy.h"
 #include "hw/sd/atfsdc010.h"
+#include "hw/dma/atcdmac300.h"
 
 /* #define DEBUG_ATFSDC010 */
 #define LOGGE(x...) qemu_log_mask(LOG_GUEST_ERROR, x)
@@ -76,6 +78,7 @@ static void atfsdc010_reset_cmd(void *opaque)
     s->mask = 0x400;
     s->feature = 4;
     s->revision = ATFSDC_REVISION;
+    s->dma_active = false;
 }
 
 static void atfsdc010_update(ATFSDC010State *s)
@@ -204,6 +207,176 @@ static void atfsdc010_fifo_run(ATFSDC010State *s)
     }
 }
 
+/*
+ * DMA mode: the transfer is staged in dma_buf a chunk at a time, and each
+ * chunk is moved to or from the card in one go from a bottom half, so the
+ * DMA controller draining or filling the data window doesn't step the
+ * card byte by byte for every word.  The bottom half only acts once the
+ * current chunk has been drained or filled.  The ATCDMAC300 can also move
+ * whole bursts between the card and guest memory through
+ * atfsdc010_dma_burst(), bypassing the data window.
+ */
+
+/* The FIFO status bits, as if dma_buf were the FIFO */
+static void atfsdc010_dma_fifo_status(ATFSDC010State *s)
+{
+    bool is_read = (s->datactrl & FTSDC_DATA_WRITE) == 0;
+
+    if (s->dma_active && s->dma_pos < s->dma_len) {
+        s->status |= is_read ? FTSDC_STATUS_FIFO_ORUN : FTSDC_STATUS_FIFO_URUN;
+    }
+}
+
+static void atfsdc010_dma_idle(ATFSDC010State *s)
+{
+    s->datactrl &= ~FTSDC_DATA_ENABLE;
+    s->dma_active = false;
+    LOG("Data engine idle\n");
+}
+
+/* All the data has been moved to or from the card */
+static void atfsdc010_dma_end(ATFSDC010State *s)
+{
+    s->status |= FTSDC_STATUS_DATAEND | FTSDC_STATUS_DATABLOCKEND;
+    LOG("DMA transfer complete\n");
+}
+
+static void atfsdc010_dma_bh(void *opaque)
+{
+    ATFSDC010State *s = opaque;
+    bool is_read = (s->datactrl & FTSDC_DATA_WRITE) == 0;
+
+    if (!s->dma_active || s->dma_pos < s->dma_len) {
+        return;
+    }
+    if (is_read) {
+        /* Wait for the read command */
+        if (s->datacnt == 0 || !sdbus_data_ready(&s->sdbus)) {
+            return;
+        }
+        s->dma_len = MIN(s->datacnt, ATFSDC010_DMA_CHUNK);
+        s->dma_pos = 0;
+        sdbus_read_data(&s->sdbus, s->dma_buf, s->dma_len);
+        s->datacnt -= s->dma_len;
+    } else {
+        sdbus_write_data(&s->sdbus, s->dma_buf, s->dma_len);
+        s->datacnt -= s->dma_len;
+        s->dma_len = MIN(s->datacnt, ATFSDC010_DMA_CHUNK);
+        s->dma_pos = 0;
+        if (s->datacnt == 0) {
+            atfsdc010_dma_idle(s);
+        }
+    }
+    if (s->datacnt == 0) {
+        atfsdc010_dma_end(s);
+    }
+    atfsdc010_dma_fifo_status(s);
+    atfsdc010_update(s);
+}
+
+static void atfsdc010_dma_start(ATFSDC010State *s)
+{
+    bool is_read = (s->datactrl & FTSDC_DATA_WRITE) == 0;
+
+    /* A read chunk is filled by the bottom half, a write one by the guest */
+    s->dma_len = is_read ? 0 : MIN(s->datacnt, ATFSDC010_DMA_CHUNK);
+    s->dma_pos = 0;
+    s->dma_active = true;
+    atfsdc010_dma_fifo_status(s);
+    qemu_bh_schedule(s->dma_bh);
+}
+
+static uint32_t atfsdc010_dma_pop(ATFSDC010State *s)
+{
+    uint32_t value = 0;
+    int n;
+
+    /* The guest may read before the bottom half has run */
+    atfsdc010_dma_bh(s);
+    if (s->dma_pos == s->dma_len) {
+        LOGGE("%s: Unexpected FIFO read\n", __func__);
+        return 0;
+    }
+    for (n = 0; n < 4 && s->dma_pos < s->dma_len; n++) {
+        value |= (uint32_t)s->dma_buf[s->dma_pos++] << (n * 8);
+    }
+    if (s->dma_pos == s->dma_len && s->datacnt == 0) {
+        atfsdc010_dma_idle(s);
+    }
+    return value;
+}
+
+static void atfsdc010_dma_push(ATFSDC010State *s, uint32_t value)
+{
+    int n;
+
+    for (n = 0; n < 4 && s->dma_pos < s->dma_len; n++) {
+        s->dma_buf[s->dma_pos++] = value;
+        value >>= 8;
+    }
+    if (s->dma_pos == s->dma_len) {
+        qemu_bh_schedule(s->dma_bh);
+    }
+}
+
+/*
+ * ATCDMAC300 burst on the data window: drain what is staged, or complete
+ * the chunk the guest has started, then move the rest of the burst
+ * straight between the card and guest memory.
+ */
+static uint64_t atfsdc010_dma_burst(ATCDMAC300Periph *p, hwaddr offset,
+                                    uint8_t *buf, uint64_t len,
+                                    bool to_device)
+{
+    ATFSDC010State *s = ATFSDC010(p);
+    bool is_read = (s->datactrl & FTSDC_DATA_WRITE) == 0;
+    uint64_t done, n;
+
+    if (offset != 0x40 || !s->dma_active || to_device == is_read) {
+        return 0;
+    }
+
+    if (is_read) {
+        done = MIN(len, s->dma_len - s->dma_pos);
+        memcpy(buf, s->dma_buf + s->dma_pos, done);
+        s->dma_pos += done;
+        if (done < len && s->datacnt && sdbus_data_ready(&s->sdbus)) {
+            n = MIN(len - done, s->datacnt);
+            sdbus_read_data(&s->sdbus, buf + done, n);
+            s->datacnt -= n;
+            done += n;
+            if (s->datacnt == 0) {
+                atfsdc010_dma_end(s);
+            }
+        }
+        if (s->dma_pos == s->dma_len && s->datacnt == 0) {
+            atfsdc010_dma_idle(s);
+        }
+    } else {
+        done = 0;
+        if (s->dma_pos) {
+            done = MIN(len, s->dma_len - s->dma_pos);
+            memcpy(s->dma_buf + s->dma_pos, buf, done);
+            s->dma_pos += done;
+            atfsdc010_dma_bh(s);
+        }
+        if (s->dma_active && s->dma_pos == 0 && done < len) {
+            n = MIN(len - done, s->datacnt);
+            sdbus_write_data(&s->sdbus, buf + done, n);
+            s->datacnt -= n;
+            done += n;
+            s->dma_len = MIN(s->datacnt, ATFSDC010_DMA_CHUNK);
+            if (s->datacnt == 0) {
+                atfsdc010_dma_idle(s);
+                atfsdc010_dma_end(s);
+            }
+        }
+    }
+    atfsdc010_dma_fifo_status(s);
+    atfsdc010_update(s);
+    return done;
+}
+
 static uint64_t
 atfsdc010_read(void *opaque, hwaddr offset, unsigned size)
 {
@@ -260,7 +433,10 @@ atfsdc010_read(void *opaque, hwaddr offset, unsigned size)
         rz = s->buswidth;
         break;
     case 0x40: /* Data Window */
-        if (s->fifo_len == 0) {
+        if (s->dma_active) {
+            rz = atfsdc010_dma_pop(s);
+            atfsdc010_update(s);
+        } else if (s->fifo_len == 0) {
             LOGGE("%s: Unexpected FIFO read\n", __func__);
         } else {
             uint32_t value;
@@ -314,7 +490,11 @@ atfsdc010_write(void *opaque, hwaddr offset,
             atfsdc010_reset_cmd(s);
         } else if (s->cmd & FTSDC_CMD_ENABLE) {
             atfsdc010_send_command(s);
-            atfsdc010_fifo_run(s);
+            if (s->dma_active) {
+                qemu_bh_schedule(s->dma_bh);
+            } else {
+                atfsdc010_fifo_run(s);
+            }
             /* The command has completed one way or the other.  */
             s->cmd &= ~FTSDC_CMD_ENABLE;
         }
@@ -324,12 +504,17 @@ atfsdc010_write(void *opaque, hwaddr offset,
         break;
     case 0x1c: /* DataCtrl */
         s->datactrl = value & 0x7f;
+        s->dma_active = false;
         if (value & FTSDC_DATA_ENABLE) {
             if (value & FTSDC_DATA_WRITE) {
                 s->status |= FTSDC_STATUS_FIFO_URUN;
             }
             s->datacnt = s->datalength;
-            atfsdc010_fifo_run(s);
+            if ((value & FTSDC_DATA_DMAENABLE) && s->datacnt) {
+                atfsdc010_dma_start(s);
+            } else {
+                atfsdc010_fifo_run(s);
+            }
         }
         break;
     case 0x20: /* DataTimer */
@@ -354,7 +539,9 @@ atfsdc010_write(void *opaque, hwaddr offset,
         s->buswidth = value & 0x7;
         break;
     case 0x40: /* Data Window */
-        if (s->datacnt == 0) {
+        if (s->dma_active) {
+            atfsdc010_dma_push(s, value);
+        } else if (s->datacnt == 0) {
             LOGGE("%s: Unexpected FIFO write\n", __func__);
         } else {
             /* we don't need to send value actually */
@@ -424,6 +611,7 @@ atfsdc010_reset(DeviceState *d)
     s->mask = 0x400;
     s->feature = 4;
     s->revision = ATFSDC_REVISION;
+    s->dma_active = false;
 
     atfsdc010_set_inserted(DEVICE(s), sdbus_get_inserted(&s->sdbus));
     atfsdc010_set_readonly(DEVICE(s), sdbus_get_readonly(&s->sdbus));
@@ -432,9 +620,13 @@ atfsdc010_reset(DeviceState *d)
 static void
 atfsdc010_realize(DeviceState *dev, Error **errp)
 {
+    ATFSDC010State *s = ATFSDC010(dev);
     DeviceState *card;
     DriveInfo *dinfo;
 
+    s->dma_bh = qemu_bh_new_guarded(atfsdc010_dma_bh, s,
+                                    &dev->mem_reentrancy_guard);
+
     /* FIXME use a qdev drive property instead of drive_get_next() */
     card = qdev_new(TYPE_SD_CARD);
     dinfo = drive_get(IF_SD, 0, 0);
@@ -459,12 +651,14 @@ static void
 atfsdc010_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *k = DEVICE_CLASS(klass);
+    ATCDMAC300PeriphClass *pc = ATCDMAC300_PERIPH_CLASS(klass);
 
     k->vmsd = &vmstate_atfsdc010;
     k->reset = atfsdc010_reset;
     /* Reason: init() method uses drive_get_next() */
     k->user_creatable = false;
     k->realize = atfsdc010_realize;
+    pc->burst = atfsdc010_dma_burst;
 }
 
 static const MemoryRegionOps atfsdc010_ops = {
@@ -496,6 +690,10 @@ static const TypeInfo atfsdc010_info = {
     .instance_size = sizeof(ATFSDC010State),
     .instance_init = atfsdc010_init,
     .class_init    = atfsdc010_class_init,
+    .interfaces = (InterfaceInfo[]) {
+        { TYPE_ATCDMAC300_PERIPH },
+        { }
+    },
 };
 
 static void atfsdc010_bus_class_init(ObjectClass *klass, void *data)
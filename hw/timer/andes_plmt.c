@@ -44,6 +44,103 @@ static uint64_t andes_cpu_riscv_read_rtc(void *opaque)
     return andes_cpu_riscv_read_rtc_raw(plmt->timebase_freq);
 }
 
+static void andes_plmt_heap_swap(AndesPLMTState *plmt, uint32_t a, uint32_t b)
+{
+    uint32_t ha = plmt->heap[a];
+    uint32_t hb = plmt->heap[b];
+
+    plmt->heap[a] = hb;
+    plmt->heap[b] = ha;
+    plmt->heap_pos[hb] = a;
+    plmt->heap_pos[ha] = b;
+}
+
+static bool andes_plmt_heap_less(AndesPLMTState *plmt, uint32_t a, uint32_t b)
+{
+    return plmt->deadline[plmt->heap[a]] < plmt->deadline[plmt->heap[b]];
+}
+
+static void andes_plmt_heap_sift(AndesPLMTState *plmt, uint32_t pos)
+{
+    uint32_t child;
+
+    while (pos > 0 && andes_plmt_heap_less(plmt, pos, (pos - 1) / 2)) {
+        andes_plmt_heap_swap(plmt, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    for (;;) {
+        child = 2 * pos + 1;
+        if (child >= plmt->heap_len) {
+            break;
+        }
+        if (child + 1 < plmt->heap_len &&
+            andes_plmt_heap_less(plmt, child + 1, child)) {
+            child++;
+        }
+        if (!andes_plmt_heap_less(plmt, child, pos)) {
+            break;
+        }
+        andes_plmt_heap_swap(plmt, pos, child);
+        pos = child;
+    }
+}
+
+static void andes_plmt_heap_set(AndesPLMTState *plmt, uint32_t hartid,
+                                int64_t deadline)
+{
+    plmt->deadline[hartid] = deadline;
+    if (plmt->heap_pos[hartid] < 0) {
+        plmt->heap[plmt->heap_len] = hartid;
+        plmt->heap_pos[hartid] = plmt->heap_len++;
+    }
+    andes_plmt_heap_sift(plmt, plmt->heap_pos[hartid]);
+}
+
+static void andes_plmt_heap_remove(AndesPLMTState *plmt, uint32_t hartid)
+{
+    int32_t pos = plmt->heap_pos[hartid];
+
+    if (pos < 0) {
+        return;
+    }
+    plmt->heap_len--;
+    if (pos != plmt->heap_len) {
+        andes_plmt_heap_swap(plmt, pos, plmt->heap_len);
+        andes_plmt_heap_sift(plmt, pos);
+    }
+    plmt->heap_pos[hartid] = -1;
+}
+
+/* Arm the timer for the earliest deadline, unless it already is */
+static void andes_plmt_heap_rearm(AndesPLMTState *plmt)
+{
+    if (!plmt->heap_len) {
+        if (plmt->armed != INT64_MAX) {
+            timer_del(plmt->timer);
+            plmt->armed = INT64_MAX;
+        }
+    } else if (plmt->deadline[plmt->heap[0]] != plmt->armed) {
+        plmt->armed = plmt->deadline[plmt->heap[0]];
+        timer_mod(plmt->timer, plmt->armed);
+    }
+}
+
+/* Raise the interrupt of every hart whose deadline has passed */
+static void andes_plmt_heap_cb(void *opaque)
+{
+    AndesPLMTState *plmt = opaque;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    uint32_t hartid;
+
+    plmt->armed = INT64_MAX;
+    while (plmt->heap_len && plmt->deadline[plmt->heap[0]] <= now) {
+        hartid = plmt->heap[0];
+        andes_plmt_heap_remove(plmt, hartid);
+        qemu_irq_raise(plmt->timer_irqs[hartid]);
+    }
+    andes_plmt_heap_rearm(plmt);
+}
+
 /*
  * Called when timecmp is written to update the QEMU timer or immediately
  * trigger timer interrupt if timecmp <= current timer value.
@@ -64,6 +161,10 @@ andes_plmt_write_timecmp(AndesPLMTState *plmt, RISCVCPU *cpu,
          * immediately raise the timer interrupt
          */
         qemu_irq_raise(plmt->timer_irqs[hartid]);
+        if (plmt->timer_heap) {
+            andes_plmt_heap_remove(plmt, hartid);
+            andes_plmt_heap_rearm(plmt);
+        }
         return;
     }
 
@@ -74,7 +175,12 @@ andes_plmt_write_timecmp(AndesPLMTState *plmt, RISCVCPU *cpu,
     /* back to ns (note args switched in muldiv64) */
     next = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
             muldiv64(diff, NANOSECONDS_PER_SECOND, plmt->timebase_freq);
-    timer_mod(plmt->timers[hartid], next);
+    if (plmt->timer_heap) {
+        andes_plmt_heap_set(plmt, hartid, next);
+        andes_plmt_heap_rearm(plmt);
+    } else {
+        timer_mod(plmt->timers[hartid], next);
+    }
 }
 
 /*
@@ -180,6 +286,7 @@ static Property andes_plmt_properties[] = {
     DEFINE_PROP_UINT32("aperture-size", AndesPLMTState, aperture_size, 0),
     DEFINE_PROP_UINT32("timebase-freq", AndesPLMTState, timebase_freq, 0),
     DEFINE_PROP_UINT32("hart-base", AndesPLMTState, hart_base, 0),
+    DEFINE_PROP_BOOL("timer-heap", AndesPLMTState, timer_heap, true),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -192,6 +299,19 @@ static void andes_plmt_realize(DeviceState *dev, Error **errp)
     plmt->timers = g_new0(QEMUTimer *, plmt->num_harts);
     plmt->timecmp = g_new0(uint64_t, plmt->num_harts);
 
+    if (plmt->timer_heap) {
+        plmt->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+                                   &andes_plmt_heap_cb, plmt);
+        plmt->deadline = g_new0(int64_t, plmt->num_harts);
+        plmt->heap = g_new0(uint32_t, plmt->num_harts);
+        plmt->heap_pos = g_new(int32_t, plmt->num_harts);
+        for (int i = 0; i < plmt->num_harts; i++) {
+            plmt->heap_pos[i] = -1;
+        }
+        plmt->heap_len = 0;
+        plmt->armed = INT64_MAX;
+    }
+
     plmt->timer_irqs = g_new(qemu_irq, plmt->num_harts);
     qdev_init_gpio_out(dev, plmt->timer_irqs, plmt->num_harts);
 
@@ -246,14 +366,16 @@ andes_plmt_create(hwaddr addr, hwaddr size, uint32_t num_harts,
         if (!env) {
             continue;
         }
-        andes_plmt_callback *cb = g_new0(andes_plmt_callback, 1);
-
         riscv_cpu_set_rdtime_fn(env, andes_cpu_riscv_read_rtc, dev);
 
-        cb->plmt = plmt;
-        cb->hartid = i;
-        plmt->timers[i] = timer_new_ns(QEMU_CLOCK_VIRTUAL,
-                                       &andes_plmt_timer_cb, cb);
+        if (!plmt->timer_heap) {
+            andes_plmt_callback *cb = g_new0(andes_plmt_callback, 1);
+
+            cb->plmt = plmt;
+            cb->hartid = i;
+            plmt->timers[i] = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+                                           &andes_plmt_timer_cb, cb);
+        }
         plmt->timecmp[i] = 0;
 
         qdev_connect_gpio_out(dev, i,
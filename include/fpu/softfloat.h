@@ -363,6 +363,10 @@ static inline bool float16_unordered_quiet(float16 a, float16 b,
 bfloat16 bfloat16_round_to_int(bfloat16, float_status *status);
 bfloat16 float32_to_bfloat16(float32, float_status *status);
 float32 bfloat16_to_float32(bfloat16, float_status *status);
+void float32_to_bfloat16_n(bfloat16 *d, const float32 *s, size_t n,
+                           float_status *status);
+void bfloat16_to_float32_n(float32 *d, const bfloat16 *s, size_t n,
+                           float_status *status);
 bfloat16 float64_to_bfloat16(float64 a, float_status *status);
 float64 bfloat16_to_float64(bfloat16 a, float_status *status);
 
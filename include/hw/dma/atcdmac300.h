@@ -21,6 +21,8 @@
 #define ATCDMAC300_H
 
 #include "hw/sysbus.h"
+#include "qemu/units.h"
+#include "qemu/timer.h"
 #include "qom/object.h"
 
 #define TYPE_ATCDMAC300 "atcdmac300"
@@ -80,6 +82,10 @@ OBJECT_DECLARE_SIMPLE_TYPE(ATCDMAC300State, ATCDMAC300)
 #define CHAN_CTL_SRC_ADDR_CTL_MASK      0x3
 #define CHAN_CTL_DST_ADDR_CTL_MASK      0x3
 
+#define CHAN_CTL_ADDR_CTL_INC           0x0
+#define CHAN_CTL_ADDR_CTL_DEC           0x1
+#define CHAN_CTL_ADDR_CTL_FIXED         0x2
+
 #define ATCDMAC300_CHAN_CTL             0x40
 #define ATCDMAC300_CHAN_TRAN_SZ         0x44
 #define ATCDMAC300_CHAN_SRC_ADDR        0x48
@@ -96,6 +102,28 @@ OBJECT_DECLARE_SIMPLE_TYPE(ATCDMAC300State, ATCDMAC300)
 #define ATCDMAC300_MAX_BURST_SIZE       1024
 #define ATCDMAC300_MAX_CHAN             0x8
 
+/* Bytes moved each time the transfer bottom half runs */
+#define ATCDMAC300_BH_BUDGET            (1 * MiB)
+/* Bytes a channel moves before the next channel of its priority */
+#define ATCDMAC300_QUANTUM              (4 * KiB)
+/* Transfer period when the bandwidth property is set */
+#define ATCDMAC300_TICK_NS              (10 * SCALE_US)
+
+/* Linked-list pointer: bit 0 selects the bus, the descriptor is 8-aligned */
+#define ATCDMAC300_LLP_ATTR_MASK        0x7
+
+/* Linked-list descriptor, little-endian in memory */
+typedef struct {
+    uint32_t ctrl;
+    uint32_t tran_size;
+    uint32_t src_addr;
+    uint32_t src_addr_h;
+    uint32_t dst_addr;
+    uint32_t dst_addr_h;
+    uint32_t ll_pointer;
+    uint32_t ll_pointer_h;
+} ATCDMAC300Desc;
+
 #define PER_CHAN_OFFSET                 0x20
 #define ATCDMAC300_FIRST_CHAN_BASE      ATCDMAC300_CHAN_CTL
 #define ATCDMAC300_GET_CHAN(reg)        (((reg - ATCDMAC300_FIRST_CHAN_BASE) / \
@@ -114,6 +142,15 @@ typedef struct {
     uint64_t ChnDstAddrH;
     uint32_t ChnLLPointer;
     uint32_t ChnLLPointerH;
+
+    /* Transfer in progress, latched when the channel is enabled */
+    uint64_t src;
+    uint64_t dst;
+    uint64_t remain;
+    uint32_t src_width;
+    uint32_t dst_width;
+    uint32_t src_ctl;
+    uint32_t dst_ctl;
 } ATCDMAC300Chan;
 
 struct ATCDMAC300State {
@@ -124,6 +161,11 @@ struct ATCDMAC300State {
     qemu_irq irq;
     MemoryRegion mmio;
     uint32_t mmio_size;
+    AddressSpace *as;
+    QEMUBH *bh;
+    QEMUTimer *timer;
+    uint64_t bandwidth;
+    int last_chan;
 
     /* ID and revision register */
     uint32_t IdRev;
@@ -142,6 +184,32 @@ struct ATCDMAC300State {
     ATCDMAC300Chan chan[ATCDMAC300_MAX_CHAN];
 };
 
+/*
+ * A device whose data FIFO the DMAC can fill or drain a whole burst at a
+ * time, instead of one element at a time through its MMIO region.
+ */
+#define TYPE_ATCDMAC300_PERIPH "atcdmac300-periph"
+
+typedef struct ATCDMAC300PeriphClass ATCDMAC300PeriphClass;
+DECLARE_CLASS_CHECKERS(ATCDMAC300PeriphClass, ATCDMAC300_PERIPH,
+                       TYPE_ATCDMAC300_PERIPH)
+#define ATCDMAC300_PERIPH(obj) \
+     INTERFACE_CHECK(ATCDMAC300Periph, (obj), TYPE_ATCDMAC300_PERIPH)
+
+typedef struct ATCDMAC300Periph ATCDMAC300Periph;
+
+struct ATCDMAC300PeriphClass {
+    InterfaceClass parent;
+    /*
+     * burst - move up to @len bytes between @buf and the FIFO at @offset
+     * in the device's MMIO region, to the device if @to_device.  Returns
+     * the number of bytes moved; the DMAC falls back to element accesses
+     * for the rest of the transfer when it is short.
+     */
+    uint64_t (*burst)(ATCDMAC300Periph *p, hwaddr offset, uint8_t *buf,
+                      uint64_t len, bool to_device);
+};
+
 void atcdmac300_create(ATCDMAC300State *atcdmac, const char *name,
                  hwaddr addr, hwaddr mmio_size, qemu_irq irq);
 
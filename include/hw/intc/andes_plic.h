@@ -113,8 +113,23 @@ typedef struct AndesPLICState {
     uint32_t *trigger_type;
     uint32_t num_irq_target;
 
+    /*
+     * Per source bitmap of the targets it can interrupt, i.e. that have it
+     * enabled while its priority is non-zero, target_longs longs each
+     */
+    unsigned long *source_targets;
+    uint32_t target_longs;
+    /* CPU of each target */
+    CPUState **target_cpu;
+
     /* interface */
     void (*andes_plic_update)(void *plic);
+    void (*andes_plic_update_target)(AndesPLICState *plic,
+        uint32_t target_id);
+    void (*parent_write_priority)(void *opaque,
+        hwaddr addr, uint64_t value, unsigned size);
+    void (*parent_write_enable)(void *opaque,
+        hwaddr addr, uint64_t value, unsigned size);
 } AndesPLICState;
 
 void andes_plichw_update(void *plic);
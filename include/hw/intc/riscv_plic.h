@@ -109,6 +109,7 @@ struct RISCVPLICState {
     uint32_t (*riscv_plic_claim)(RISCVPLICState *plic,
         uint32_t addrid);
     void (*riscv_plic_irq_request)(void *opaque, int irq, int level);
+    int (*riscv_plic_post_load)(void *opaque, int version_id);
 };
 
 DeviceState *riscv_plic_create(hwaddr addr, char *hart_config,
@@ -12,9 +12,20 @@
 
 #include "hw/sysbus.h"
 #include "net/net.h"
+#include "qemu/timer.h"
 
 #define ATFMAC100_FRAME_SIZE_MAX (1518)
 #define ATFMAC100_FRAME_BUFFER_SIZE (1 << 11)
+#define ATFMAC100_TX_MAX_FRAGS (16)
+#define ATFMAC100_RX_BATCH_MAX (32)
+
+/* RX & TX Descriptor */
+typedef struct {
+    uint32_t des0;
+    uint32_t des1;
+    uint32_t des2;
+    uint32_t des3;
+} ATFMAC100Desc;
 
 #define TYPE_ATFMAC100 "atfmac100"
 #define ATFMAC100(obj) OBJECT_CHECK(ATFMAC100State, (obj), TYPE_ATFMAC100)
@@ -31,6 +42,8 @@ typedef struct ATFMAC100State {
 
     /* Static properties */
     uint32_t revision;
+    uint32_t rx_coalesce_frames;
+    uint32_t rx_coalesce_usecs;
 
     /* registers */
     uint32_t isr;
@@ -85,6 +98,14 @@ typedef struct ATFMAC100State {
     uint32_t rx_desc_addr;
     uint32_t tx_desc_addr;
     uint8_t frame[ATFMAC100_FRAME_BUFFER_SIZE];
+    bool tx_blocked;
+
+    /* RX descriptors waiting for write-back, and interrupt coalescing */
+    ATFMAC100Desc rx_wb[ATFMAC100_RX_BATCH_MAX];
+    uint32_t rx_wb_addr;
+    int rx_wb_count;
+    uint32_t rx_pending_frames;
+    QEMUTimer *rx_coalesce_timer;
 
 } ATFMAC100State;
 
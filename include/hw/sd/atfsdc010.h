@@ -21,6 +21,7 @@
 
 #define ATFSDC_REVISION     0x00030107
 #define ATFSDC010_FIFO_LEN  16
+#define ATFSDC010_DMA_CHUNK 4096
 
 typedef struct {
     SysBusDevice parent_obj;
@@ -55,6 +56,13 @@ typedef struct {
     int fifo_pos;
     int fifo_len;
     uint32_t fifo[ATFSDC010_FIFO_LEN];
+
+    /* DMA mode staging buffer, for up to one chunk of the transfer */
+    QEMUBH *dma_bh;
+    bool dma_active;
+    uint8_t dma_buf[ATFSDC010_DMA_CHUNK];
+    uint32_t dma_len;
+    uint32_t dma_pos;
     qemu_irq irq;
     /* GPIO outputs for 'card is readonly' and 'card inserted' */
     qemu_irq card_readonly;
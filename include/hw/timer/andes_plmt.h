@@ -31,6 +31,17 @@ typedef struct AndesPLMTState {
     uint64_t *timecmp;
     QEMUTimer **timers;
 
+    /*
+     * timer-heap mode: the pending deadlines (QEMU_CLOCK_VIRTUAL ns) of
+     * all harts in a min-heap, with a single timer for the earliest one
+     */
+    QEMUTimer *timer;
+    int64_t *deadline;
+    uint32_t *heap;
+    int32_t *heap_pos;
+    uint32_t heap_len;
+    int64_t armed;
+
     /*< public >*/
     MemoryRegion mmio;
     uint32_t hartid_base;
@@ -40,6 +51,7 @@ typedef struct AndesPLMTState {
     uint32_t aperture_size;
     uint32_t timebase_freq;
     uint32_t hart_base;
+    bool timer_heap;
     qemu_irq *timer_irqs;
 } AndesPLMTState;
 
@@ -16,12 +16,8 @@
 #include "qapi/error.h"
 #include "qemu/cutils.h"
 
-typedef struct AndesConfig {
-    const char *id;
-    const char *name;
-    char **value;
-} AndesConfig;
-
+void andes_config_init(void);
+void andes_config_check_unused(void);
 int andes_config_query(const char *id, const char *name, char **value);
 int qemu_andes_config_options(const char *optarg);
 bool andes_config_bool(const char *id, const char *name, uint64_t *val);
@@ -14,76 +14,166 @@ QemuOptsList qemu_andes_config_opts = {
     },
 };
 
-static int andes_config_query_func(void *opaque, QemuOpts *opts, Error **errp)
+/*
+ * The options are parsed into a table once the command line has been
+ * read, as every hart looks up every CSR setting when it is realized and
+ * reset.  Each value is parsed as both a bool and a number up front, and
+ * the getters pick the type they need.  Entries that are never looked up
+ * are reported once the machine has been created, which catches misspelt
+ * names.
+ */
+typedef struct AndesConfigEntry {
+    char *str;
+    bool bool_ok;
+    bool bval;
+    int number_ret;
+    uint64_t number;
+    bool warned;
+    bool used;
+} AndesConfigEntry;
+
+/* id ("" for no id) -> name -> AndesConfigEntry */
+static GHashTable *andes_config_table;
+
+static void andes_config_parse(AndesConfigEntry *e)
 {
+    const char *value = e->str;
+
+    e->bool_ok = qapi_bool_parse(NULL, value, &e->bval, NULL);
+    if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
+        e->number_ret = qemu_strtou64(value + 2, NULL, 16, &e->number);
+    } else {
+        e->number_ret = qemu_strtou64(value, NULL, 0, &e->number);
+    }
+}
+
+static int andes_config_add(void *opaque, QemuOpts *opts, Error **errp)
+{
+    GHashTable *names;
     QemuOpt *opt;
-    AndesConfig *user_opts = (AndesConfig *)opaque;
+
+    names = g_hash_table_lookup(andes_config_table, opts->id ?: "");
+    if (!names) {
+        names = g_hash_table_new(g_str_hash, g_str_equal);
+        g_hash_table_insert(andes_config_table, opts->id ?: "", names);
+    }
+
     QTAILQ_FOREACH(opt, &opts->head, next) {
-        if (((!opts->id && !user_opts->id) || (opts->id && user_opts->id &&
-            !strcmp(user_opts->id, opts->id))) &&
-            !strcmp(user_opts->name, opt->name)) {
-            *user_opts->value = opt->str;
-            return 1;
+        AndesConfigEntry *e;
+
+        /* The first setting of a name wins, as it always has */
+        if (g_hash_table_contains(names, opt->name)) {
+            continue;
         }
+        e = g_new0(AndesConfigEntry, 1);
+        e->str = opt->str;
+        andes_config_parse(e);
+        if (!e->bool_ok && e->number_ret) {
+            warn_report("andes-config: '%s' is neither a boolean nor "
+                        "a number for '%s'", e->str, opt->name);
+            e->warned = true;
+        }
+        g_hash_table_insert(names, opt->name, e);
     }
     return 0;
+}
+
+void andes_config_init(void)
+{
+    assert(!andes_config_table);
+    andes_config_table = g_hash_table_new(g_str_hash, g_str_equal);
+    qemu_opts_foreach(&qemu_andes_config_opts, andes_config_add, NULL, NULL);
+}
+
+void andes_config_check_unused(void)
+{
+    GHashTableIter iter, names_iter;
+    gpointer id, names, name, value;
 
+    g_hash_table_iter_init(&iter, andes_config_table);
+    while (g_hash_table_iter_next(&iter, &id, &names)) {
+        g_hash_table_iter_init(&names_iter, names);
+        while (g_hash_table_iter_next(&names_iter, &name, &value)) {
+            AndesConfigEntry *e = value;
+
+            if (!e->used) {
+                warn_report("andes-config%s%s: '%s' was not used",
+                            *(char *)id ? " " : "", (char *)id,
+                            (char *)name);
+            }
+        }
+    }
+}
+
+static AndesConfigEntry *andes_config_lookup(const char *id, const char *name)
+{
+    GHashTable *names;
+    AndesConfigEntry *e;
+
+    assert(andes_config_table);
+    names = g_hash_table_lookup(andes_config_table, id ?: "");
+    e = names ? g_hash_table_lookup(names, name) : NULL;
+    if (e) {
+        e->used = true;
+    }
+    return e;
 }
 
 int andes_config_query(const char *id, const char *name, char **value)
 {
-    AndesConfig opts;
-    opts.id = id;
-    opts.name = name;
-    opts.value = value;
-    return qemu_opts_foreach(&qemu_andes_config_opts,
-        andes_config_query_func, &opts, NULL);
+    AndesConfigEntry *e = andes_config_lookup(id, name);
+
+    if (!e) {
+        return 0;
+    }
+    *value = e->str;
+    return 1;
 }
 
 bool andes_config_bool(const char *id, const char *name, uint64_t *val)
 {
-    char *value;
-    bool bval;
+    AndesConfigEntry *e;
+
     /* For CSR mask special config, name is NULL will always set bit mask */
     if (!name) {
         *val = true;
         return true;
     }
-    if (andes_config_query(id, name, &value)) {
-        if (qapi_bool_parse(name, value, &bval, NULL)) {
-            *val = bval;
-            return true;
-        }
+    e = andes_config_lookup(id, name);
+    if (e && e->bool_ok) {
+        *val = e->bval;
+        return true;
     }
     return false;
 }
 
 bool andes_config_number(const char *id, const char *name, uint64_t *val)
 {
-    char *value;
-    int ret;
+    AndesConfigEntry *e;
 
     /* For CSR mask special config, number type name cannot be set to NULL */
     if (!name) {
         return false;
     }
-    if (andes_config_query(id, name, &value)) {
-        if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
-            ret = qemu_strtou64(value + 2, NULL, 16, val);
-        } else {
-            ret = qemu_strtou64(value, NULL, 0, val);
-        }
-        if (ret == -ERANGE) {
-            error_setg(&error_warn,
-                "Value '%s' is too large for parameter '%s'", value, name);
-            return false;
-        }
-        if (ret) {
-            error_setg(&error_warn,
-                QERR_INVALID_PARAMETER_VALUE, name, "a number");
-            return false;
+    e = andes_config_lookup(id, name);
+    if (!e) {
+        return false;
+    }
+    if (e->number_ret) {
+        /* Once, rather than for every hart */
+        if (!e->warned) {
+            e->warned = true;
+            if (e->number_ret == -ERANGE) {
+                error_setg(&error_warn,
+                    "Value '%s' is too large for parameter '%s'", e->str,
+                    name);
+            } else {
+                error_setg(&error_warn,
+                    QERR_INVALID_PARAMETER_VALUE, name, "a number");
+            }
         }
-        return true;
+        return false;
     }
-    return false;
+    *val = e->number;
+    return true;
 }
@@ -65,6 +65,7 @@
 #include "ui/console.h"
 #include "ui/input.h"
 #include "sysemu/sysemu.h"
+#include "qemu/andes-config.h"
 #include "sysemu/numa.h"
 #include "sysemu/hostmem.h"
 #include "exec/gdbstub.h"
@@ -2676,6 +2677,9 @@ static void qemu_machine_creation_done(void)
 
     qdev_machine_creation_done();
 
+    /* The harts have read their settings by the time they are reset */
+    andes_config_check_unused();
+
     if (machine->cgs) {
         /*
          * Verify that Confidential Guest Support has actually been initialized
@@ -3643,6 +3647,7 @@ void qemu_init(int argc, char **argv)
 
     qemu_validate_options(machine_opts_dict);
     qemu_process_sugar_options();
+    andes_config_init();
 
     /*
      * These options affect everything else and should be processed
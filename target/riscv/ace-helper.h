@@ -16,6 +16,11 @@
 
 /* define ACE agent version, just use int value */
 #define ACE_AGENT_VERSION   100
+/*
+ * v2 agents additionally export ace_agent_insn_sigs(), see AceInsnSig.
+ * QEMU still accepts agents reporting ACE_AGENT_VERSION.
+ */
+#define ACE_AGENT_VERSION_V2    200
 
 enum ACE_CB_NAME {
     ACE_GET_XRF = 0,
@@ -36,6 +41,11 @@ enum ACE_CB_NAME {
     ACE_GET_CPU_PRIV,
     ACE_GET_ACES,
     ACE_SET_ACES,
+    ACE_GET_MEM_SPAN,
+    ACE_PUT_MEM_SPAN,
+    ACE_GET_VRF_VIEW,
+    ACE_GET_AGENT_CTX,
+    ACE_INVALIDATE_DECODE,
     ACE_CB_NAME_MAX
 };
 
@@ -76,18 +86,159 @@ typedef void (*func3m)(void *, uint64_t x, uint64_t y, uint32_t z);
 #define FUNC_2M(f, p0, p1, p2) ((func2m)(f))(p0, p1, p2)
 #define FUNC_3M(f, p0, p1, p2, p3) ((func3m)(f))(p0, p1, p2, p3)
 
+/*
+ * For Get VRF view
+ *
+ * ACE_GET_VRF_VIEW points view->data at vector register index inside the
+ * CPU state instead of copying it like ACE_GET_VRF/ACE_SET_VRF.  The
+ * agent sets view->version to ACE_VRF_VIEW_VERSION before the call, the
+ * other fields are filled in by QEMU.  access is a mask of ACE_MEM_READ
+ * and ACE_MEM_WRITE; the data must not be modified without ACE_MEM_WRITE.
+ * The view is valid until the instruction completes.  Registers are
+ * contiguous, so a register group starting at index can be accessed as
+ * LMUL * vlenb bytes.  Returns 0 on success.
+ *
+ * Element ordering: each register is vlenb / 8 host-endian 64-bit words,
+ * word 0 holding the lowest-numbered elements.  On a little-endian host
+ * (host_be == 0) element i of width SEW bytes is at byte offset i * SEW.
+ * On a big-endian host the elements are reversed within each word, so
+ * element i is at byte offset (i * SEW) ^ (8 - SEW).  This holds for any
+ * VLEN.
+ */
+#define ACE_VRF_VIEW_VERSION    1
+typedef struct AceVrfView {
+    uint32_t version;
+    uint32_t vlenb;
+    uint32_t host_be;
+    uint8_t *data;
+} AceVrfView;
+typedef int32_t (*func3vv)(void *, uint32_t x, uint32_t y, AceVrfView *z);
+#define FUNC_3VV(f, p0, p1, p2, p3) ((func3vv)(f))(p0, p1, p2, p3)
+
+/*
+ * For Get/Put Mem span
+ *
+ * ACE_GET_MEM_SPAN returns a host pointer to size bytes of guest memory
+ * at the virtual address, accessible as requested by the ACE_MEM_* bits.
+ * The span is probed once, so any fault is raised before the agent
+ * touches memory.  If the span crosses a page or isn't backed by RAM, the
+ * pointer refers to a bounce buffer, which is filled for ACE_MEM_READ and
+ * written back by ACE_PUT_MEM_SPAN for ACE_MEM_WRITE.  At most
+ * ACE_MEM_SPAN_MAX spans can be held at once, NULL is returned beyond
+ * that.  Every span must be released with ACE_PUT_MEM_SPAN before the
+ * instruction completes.
+ */
+#define ACE_MEM_READ        (1u << 0)
+#define ACE_MEM_WRITE       (1u << 1)
+#define ACE_MEM_SPAN_MAX    4
+typedef void* (*func3s)(void *, uint64_t x, uint32_t y, uint32_t z);
+typedef void (*func1s)(void *, void *x);
+#define FUNC_3S(f, p0, p1, p2, p3) ((func3s)(f))(p0, p1, p2, p3)
+#define FUNC_1S(f, p0, p1) ((func1s)(f))(p0, p1)
+
+/* For Get agent context, see ace_agent_context_new() */
+typedef void* (*func0p)(void *);
+#define FUNC_0P(f, p0) ((func0p)(f))(p0)
+
+/* For Invalidate decode, see ace_agent_decode() */
+typedef void (*func0v)(void *);
+#define FUNC_0V(f, p0) ((func0v)(f))(p0)
+
 /* For Get/Set ACM */
 typedef AcmStatus (*func3a)(void *, uint64_t x, uint32_t y, char *z);
 #define FUNC_3A(f, p0, p1, p2, p3) ((func3a)(f))(p0, p1, p2, p3)
 
+/*
+ * v2 operand signatures
+ *
+ * An opcode matched by a signature is executed by calling its exec
+ * function with the values of up to ACE_INSN_MAX_SRC source GPRs.  The
+ * returned value is written to the rd GPR by the translated code.  Each
+ * register field is a 5-bit field located at the given bit position of
+ * the 32-bit opcode, or ACE_FIELD_NONE if the operand is not used.
+ *
+ * exec must set *status to 0 on success; any other value raises an
+ * illegal instruction exception and leaves rd unmodified.
+ */
+#define ACE_INSN_MAX_SRC    3
+#define ACE_FIELD_NONE      0xff
+
+/*
+ * exec only depends on the opcode and the source values and produces
+ * only rd: it doesn't call back into QEMU.  Such instructions don't end
+ * the translation block.
+ */
+#define ACE_INSN_NO_SIDE_EFFECTS    (1u << 0)
+
+typedef uint64_t (*AceInsnExec)(void *, uint32_t opcode, uint64_t src0,
+                                uint64_t src1, uint64_t src2,
+                                int32_t *status);
+
+typedef struct AceInsnSig {
+    uint32_t match;
+    uint32_t mask;
+    uint8_t rd_shift;
+    uint8_t rs_shift[ACE_INSN_MAX_SRC];
+    uint32_t flags;
+    AceInsnExec exec;
+} AceInsnSig;
+
+/*
+ * Translation-time decode
+ *
+ * An agent may export ace_agent_decode(), which QEMU calls when it first
+ * translates an opcode that no v2 signature matches.  On success the
+ * agent fills an AceDecodedInsn and returns 0, and from then on the
+ * instruction executes by calling exec with the operands, without going
+ * through ace_agent_run_insn() and the agent's decoder.  exec returns 0
+ * on success, like ace_agent_run_insn().  Otherwise the opcode is run by
+ * ace_agent_run_insn() as before.  ace_agent_decode() must not call back
+ * into QEMU.
+ *
+ * The operands are owned by the agent and must remain valid while it is
+ * loaded.  When the decoding changes, e.g. the agent reloads its
+ * instruction library, the agent calls ACE_INVALIDATE_DECODE: QEMU then
+ * forgets every decoded opcode and flushes the translated code.  Old
+ * operands may still be used until every vCPU leaves the translated code.
+ */
+typedef int32_t (*AceDecodedExec)(void *, const void *operands);
+
+typedef struct AceDecodedInsn {
+    AceDecodedExec exec;
+    const void *operands;
+} AceDecodedInsn;
+
+/*
+ * Per-hart contexts and thread safety
+ *
+ * An agent may export ace_agent_flags().  With ACE_AGENT_THREAD_SAFE set,
+ * it is called concurrently from every vCPU thread that runs in parallel
+ * (MTTCG, or the threads of a linux-user guest).  Otherwise QEMU runs one
+ * agent call at a time, but only once vCPUs do run in parallel.
+ *
+ * An agent may also export ace_agent_context_new(), which each hart calls
+ * after ace_agent_register() with its hart ID.  The returned pointer is
+ * returned to the agent by the ACE_GET_AGENT_CTX callback, so that the
+ * state of a hart is reached without a lookup or a lock.
+ */
+#define ACE_AGENT_THREAD_SAFE       (1u << 0)
+
 typedef int32_t (*AceAgentReg)(void *, void *, uint32_t,
                                const char*, uint64_t, int32_t);
 typedef int32_t (*AceAgentRunInsn)(void *, uint32_t, uint64_t);
 typedef int32_t (*AceAgentVersion)(void *);
 typedef char* (*AceAgentCopilotVersion)(void *, uint64_t);
+typedef int32_t (*AceAgentInsnSigs)(void *, const AceInsnSig **, uint32_t *);
+typedef uint32_t (*AceAgentFlags)(void *);
+typedef int32_t (*AceAgentDecode)(void *, uint32_t, AceDecodedInsn *);
+typedef void *(*AceAgentContextNew)(void *, uint64_t);
 EXPORT_C int32_t ace_agent_register(void *, AceAgentFuncPtr *,
                                     uint32_t, const char *, uint64_t, int32_t);
 EXPORT_C int32_t ace_agent_run_insn(void *, uint32_t, uint64_t);
 EXPORT_C int32_t ace_agent_version(void *);
 EXPORT_C const char *ace_agent_copilot_version(void *, uint64_t);
+EXPORT_C int32_t ace_agent_insn_sigs(void *, const AceInsnSig **, uint32_t *);
+EXPORT_C uint32_t ace_agent_flags(void *);
+EXPORT_C int32_t ace_agent_decode(void *, uint32_t, AceDecodedInsn *);
+EXPORT_C void *ace_agent_context_new(void *, uint64_t);
 #endif
@@ -17,9 +17,15 @@ uint64_t qemu_get_FRF(CPURISCVState *env, uint32_t index);
 void qemu_set_FRF(CPURISCVState *env, uint32_t index, uint64_t value);
 unsigned char *qemu_get_VRF(CPURISCVState *env, uint32_t index);
 void qemu_set_VRF(CPURISCVState *env, uint32_t index, unsigned char *value);
+int32_t qemu_get_VRF_view(CPURISCVState *env, uint32_t index,
+                          uint32_t access, AceVrfView *view);
 uint64_t qemu_get_MEM(CPURISCVState *env, uint64_t vaddr, uint32_t size);
 void qemu_set_MEM(CPURISCVState *env, uint64_t vaddr,
                   uint64_t value, uint32_t size);
+void *qemu_get_MEM_span(CPURISCVState *env, uint64_t vaddr, uint32_t size,
+                        uint32_t access);
+void qemu_put_MEM_span(CPURISCVState *env, void *host);
+void qemu_ace_release_MEM_spans(CPURISCVState *env);
 uint64_t qemu_get_CSR(CPURISCVState *env, uint32_t index, uint64_t mask);
 void qemu_set_CSR(CPURISCVState *env, uint32_t index,
                   uint64_t mask, uint64_t value);
@@ -44,9 +50,29 @@ uint64_t qemu_get_hart_id(CPURISCVState *env);
 /* CPU Priv Mode */
 uint32_t qemu_get_cpu_priv(CPURISCVState *env);
 
+/* Agent context of the hart */
+void *qemu_get_agent_ctx(CPURISCVState *env);
+
+/* Translation-time decode */
+void qemu_ace_invalidate_decode(CPURISCVState *env);
+const AceDecodedInsn *qemu_ace_agent_decode(CPURISCVState *env,
+                                            uint32_t opcode);
+int32_t qemu_ace_agent_run_decoded(CPURISCVState *env,
+                                   const AceDecodedInsn *insn, uintptr_t ra);
+
 int32_t qemu_ace_agent_load(const char *filename);
 int32_t qemu_ace_agent_load_symbol(const char *symbol_name, void **func_ptr);
 int32_t qemu_ace_agent_register(CPURISCVState *env, const char *extlibpath,
                                 int32_t multi);
 int32_t qemu_ace_agent_run_insn(CPURISCVState *env, uint32_t opcode);
+int32_t qemu_ace_agent_run_insn_ra(CPURISCVState *env, uint32_t opcode,
+                                   uintptr_t ra);
+
+/* v2 ABI: operand signatures declared by the agent at load time */
+int32_t qemu_ace_agent_load_sigs(CPURISCVState *env);
+int32_t qemu_ace_agent_find_insn(uint32_t opcode);
+const AceInsnSig *qemu_ace_agent_insn_sig(uint32_t index);
+uint64_t qemu_ace_agent_exec(CPURISCVState *env, const AceInsnSig *sig,
+                             uint32_t opcode, uint64_t src0, uint64_t src1,
+                             uint64_t src2, int32_t *status, uintptr_t ra);
 #endif
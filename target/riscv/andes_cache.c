@@ -0,0 +1,493 @@
+/*
+ * Andes L1I/L1D/L2 cache timing model
+ *
+ * Tracks tags only, to count the hits, misses and write-backs that the
+ * guest would see and the cycles it would stall for them.  The L1 caches
+ * take their geometry from micm_cfg/mdcm_cfg and are private to a hart,
+ * the L2 is shared by all harts and is configured with -andes-config:
+ *
+ *   -andes-config cache-model=on,cache-l2-size=262144,cache-l2-way=16,
+ *                 cache-l2-line=64,cache-l2-cycles=12,cache-mem-cycles=100
+ *
+ * Lookups use the virtual address of the access, as the Andes L1 caches
+ * are virtually indexed.
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/andes-config.h"
+#include "qemu/error-report.h"
+#include "qemu/host-utils.h"
+#include "qemu/thread.h"
+#include "cpu.h"
+#include "exec/helper-proto.h"
+#include "andes_cache.h"
+#include "pmu.h"
+
+/* Flags in the low bits of a tag, the line address is above them */
+#define LINE_VALID      (1 << 0)
+#define LINE_DIRTY      (1 << 1)
+#define LINE_LOCK       (1 << 2)
+#define LINE_FLAGS      3
+
+typedef struct AndesCache {
+    uint64_t *tag;
+    uint64_t *stamp;
+    uint64_t clock;
+    uint32_t set_bits;
+    uint32_t ways;
+    uint32_t line_bits;
+} AndesCache;
+
+typedef struct AndesCacheModel {
+    AndesCache l1i;
+    AndesCache l1d;
+} AndesCacheModel;
+
+static AndesCache andes_l2;
+static QemuSpin andes_l2_lock;
+static uint32_t andes_l2_cycles = 10;
+static uint32_t andes_mem_cycles = 100;
+
+static void andes_cache_init(AndesCache *c, uint32_t set_bits, uint32_t ways,
+                             uint32_t line_bits)
+{
+    c->set_bits = set_bits;
+    c->ways = ways;
+    c->line_bits = line_bits;
+    c->tag = g_new0(uint64_t, ways << set_bits);
+    c->stamp = g_new0(uint64_t, ways << set_bits);
+    c->clock = 0;
+}
+
+static void andes_cache_flush(AndesCache *c)
+{
+    if (c->tag) {
+        memset(c->tag, 0, (sizeof(*c->tag) * c->ways) << c->set_bits);
+    }
+}
+
+static inline uint64_t *andes_cache_set(AndesCache *c, uint64_t line)
+{
+    return &c->tag[(line & MAKE_64BIT_MASK(0, c->set_bits)) * c->ways];
+}
+
+/* Returns the way that holds @line, or -1 */
+static int andes_cache_lookup(AndesCache *c, uint64_t line)
+{
+    uint64_t *set = andes_cache_set(c, line);
+    uint64_t want = (line << LINE_FLAGS) | LINE_VALID;
+    int way;
+
+    for (way = 0; way < c->ways; way++) {
+        if ((set[way] & ~(uint64_t)(LINE_DIRTY | LINE_LOCK)) == want) {
+            return way;
+        }
+    }
+    return -1;
+}
+
+static void andes_cache_touch(AndesCache *c, uint64_t line, int way)
+{
+    uint64_t *set = andes_cache_set(c, line);
+
+    c->stamp[(set - c->tag) + way] = ++c->clock;
+}
+
+/*
+ * Pick the way to fill with @line: an invalid one, else the least recently
+ * used one that is not locked.  Returns -1 if the whole set is locked, in
+ * which case the access bypasses the cache.  The victim tag is returned in
+ * @victim.
+ */
+static int andes_cache_fill(AndesCache *c, uint64_t line, uint64_t *victim)
+{
+    uint64_t *set = andes_cache_set(c, line);
+    uint64_t *stamp = c->stamp + (set - c->tag);
+    uint64_t oldest = UINT64_MAX;
+    int way, pick = -1;
+
+    for (way = 0; way < c->ways; way++) {
+        if (!(set[way] & LINE_VALID)) {
+            pick = way;
+            break;
+        }
+        if (!(set[way] & LINE_LOCK) && stamp[way] < oldest) {
+            oldest = stamp[way];
+            pick = way;
+        }
+    }
+    if (pick < 0) {
+        return -1;
+    }
+
+    *victim = set[pick];
+    set[pick] = (line << LINE_FLAGS) | LINE_VALID;
+    stamp[pick] = ++c->clock;
+    return pick;
+}
+
+/* Refill from the L2 or memory, returns the stall cycles */
+static uint32_t andes_cache_l2_access(vaddr addr, bool store)
+{
+    uint64_t line, victim;
+    uint32_t cycles;
+    int way;
+
+    if (!andes_l2.tag) {
+        return andes_mem_cycles;
+    }
+
+    line = addr >> andes_l2.line_bits;
+    qemu_spin_lock(&andes_l2_lock);
+    way = andes_cache_lookup(&andes_l2, line);
+    if (way >= 0) {
+        andes_cache_touch(&andes_l2, line, way);
+        cycles = andes_l2_cycles;
+    } else {
+        way = andes_cache_fill(&andes_l2, line, &victim);
+        cycles = andes_l2_cycles + andes_mem_cycles;
+    }
+    if (store && way >= 0) {
+        andes_cache_set(&andes_l2, line)[way] |= LINE_DIRTY;
+    }
+    qemu_spin_unlock(&andes_l2_lock);
+    return cycles;
+}
+
+static void andes_cache_writeback(CPURISCVState *env, AndesCache *c,
+                                  uint64_t tag)
+{
+    if ((tag & (LINE_VALID | LINE_DIRTY)) == (LINE_VALID | LINE_DIRTY)) {
+        riscv_pmu_incr_ctr(env_archcpu(env), RISCV_PMU_EVENT_ANDES_DCACHE_WB);
+        andes_cache_l2_access((tag >> LINE_FLAGS) << c->line_bits, true);
+    }
+}
+
+/* Returns true on a hit, and adds the refill cycles to @cycles on a miss */
+static bool andes_cache_line_access(CPURISCVState *env, AndesCache *c,
+                                    uint64_t line, bool store,
+                                    uint32_t *cycles)
+{
+    uint64_t victim = 0;
+    int way = andes_cache_lookup(c, line);
+    bool hit = way >= 0;
+
+    if (hit) {
+        andes_cache_touch(c, line, way);
+    } else {
+        *cycles += andes_cache_l2_access(line << c->line_bits, false);
+        way = andes_cache_fill(c, line, &victim);
+        andes_cache_writeback(env, c, victim);
+    }
+    if (store && way >= 0) {
+        andes_cache_set(c, line)[way] |= LINE_DIRTY;
+    }
+    return hit;
+}
+
+static bool andes_cache_enabled(CPURISCVState *env, AndesCache *c, int bit)
+{
+    return c->tag &&
+           (env->andes_csr.csrno[CSR_MCACHE_CTL] & BIT(bit));
+}
+
+void andes_cache_access(CPURISCVState *env, vaddr addr, uint32_t len,
+                        bool store)
+{
+    AndesCacheModel *m = env->andes_cache;
+    RISCVCPU *cpu = env_archcpu(env);
+    AndesCache *c = &m->l1d;
+    uint64_t line, last;
+    uint32_t cycles = 0;
+
+    if (!andes_cache_enabled(env, c, V5_MCACHE_CTL_DC_EN)) {
+        if (!store) {
+            riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_UNCACHED_LOAD);
+        }
+        return;
+    }
+
+    last = (addr + MAX(len, 1) - 1) >> c->line_bits;
+    for (line = addr >> c->line_bits; line <= last; line++) {
+        riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_DCACHE_ACCESS);
+        riscv_pmu_incr_ctr(cpu, store ?
+                           RISCV_PMU_EVENT_ANDES_DCACHE_STORE_ACCESS :
+                           RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_ACCESS);
+        if (!andes_cache_line_access(env, c, line, store, &cycles)) {
+            riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_DCACHE_MISS);
+            riscv_pmu_incr_ctr(cpu, store ?
+                               RISCV_PMU_EVENT_ANDES_DCACHE_STORE_MISS :
+                               RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_MISS);
+        }
+    }
+    if (cycles) {
+        riscv_pmu_add_ctr(cpu, RISCV_PMU_EVENT_ANDES_DCACHE_FILL_CYCLES,
+                          cycles);
+    }
+}
+
+static void andes_cache_fetch(CPURISCVState *env, vaddr addr)
+{
+    AndesCacheModel *m = env->andes_cache;
+    RISCVCPU *cpu = env_archcpu(env);
+    AndesCache *c = &m->l1i;
+    uint32_t cycles = 0;
+
+    if (!andes_cache_enabled(env, c, V5_MCACHE_CTL_IC_EN)) {
+        riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_UNCACHED_FETCH);
+        return;
+    }
+
+    riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_ICACHE_ACCESS);
+    if (!andes_cache_line_access(env, c, addr >> c->line_bits, false,
+                                 &cycles)) {
+        riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_ANDES_ICACHE_MISS);
+        riscv_pmu_add_ctr(cpu, RISCV_PMU_EVENT_ANDES_ICACHE_FILL_CYCLES,
+                          cycles);
+    }
+}
+
+void HELPER(andes_cache_fetch)(CPURISCVState *env, target_ulong addr)
+{
+    andes_cache_fetch(env, addr);
+}
+
+void HELPER(andes_cache_data)(CPURISCVState *env, target_ulong addr,
+                              uint32_t info)
+{
+    andes_cache_access(env, addr, info & ANDES_CACHE_SIZE_MASK,
+                       info & ANDES_CACHE_STORE);
+}
+
+int andes_cache_fetch_line_bits(CPURISCVState *env)
+{
+    AndesCacheModel *m = env->andes_cache;
+
+    /* Without an I-cache, fetches are counted once per instruction */
+    return m->l1i.tag ? m->l1i.line_bits : 1;
+}
+
+static void andes_cache_cctl_line(CPURISCVState *env, AndesCache *c,
+                                  uint64_t *tag, bool wb, bool inval)
+{
+    if (wb) {
+        andes_cache_writeback(env, c, *tag);
+        *tag &= ~(uint64_t)LINE_DIRTY;
+    }
+    if (inval) {
+        *tag = 0;
+    }
+}
+
+/* The index is {way, set, offset} */
+static void andes_cache_cctl_ix(CPURISCVState *env, AndesCache *c,
+                                target_ulong ix, bool wb, bool inval)
+{
+    uint32_t set = (ix >> c->line_bits) & MAKE_64BIT_MASK(0, c->set_bits);
+    uint32_t way = (ix >> (c->line_bits + c->set_bits)) % c->ways;
+
+    andes_cache_cctl_line(env, c, &c->tag[set * c->ways + way], wb, inval);
+}
+
+static void andes_cache_cctl_va(CPURISCVState *env, AndesCache *c,
+                                target_ulong addr, bool wb, bool inval)
+{
+    uint64_t line = addr >> c->line_bits;
+    int way = andes_cache_lookup(c, line);
+
+    if (way >= 0) {
+        andes_cache_cctl_line(env, c, &andes_cache_set(c, line)[way],
+                              wb, inval);
+    }
+}
+
+static void andes_cache_cctl_lock(CPURISCVState *env, AndesCache *c,
+                                  target_ulong addr, bool lock)
+{
+    uint64_t line = addr >> c->line_bits;
+    uint64_t victim = 0;
+    int way = andes_cache_lookup(c, line);
+
+    /* Locking a line that is not there fills it first */
+    if (way < 0 && lock) {
+        andes_cache_l2_access(addr, false);
+        way = andes_cache_fill(c, line, &victim);
+        andes_cache_writeback(env, c, victim);
+    }
+    if (way >= 0) {
+        if (lock) {
+            andes_cache_set(c, line)[way] |= LINE_LOCK;
+        } else {
+            andes_cache_set(c, line)[way] &= ~(uint64_t)LINE_LOCK;
+        }
+    }
+}
+
+static void andes_cache_cctl_all(CPURISCVState *env, AndesCache *c,
+                                 bool wb, bool inval)
+{
+    uint32_t i;
+
+    for (i = 0; i < (c->ways << c->set_bits); i++) {
+        andes_cache_cctl_line(env, c, &c->tag[i], wb, inval);
+    }
+}
+
+/*
+ * Run CCTL command @cmd with the address or index in @addr.  Returns how
+ * far the begin address register moves on, one line for the VA and index
+ * commands.
+ */
+target_ulong andes_cache_cctl(CPURISCVState *env, target_ulong cmd,
+                              target_ulong addr)
+{
+    AndesCacheModel *m = env->andes_cache;
+    AndesCache *d = &m->l1d;
+    AndesCache *i = &m->l1i;
+    AndesCache *c;
+
+    switch (cmd) {
+    case ANDES_CCTL_L1D_VA_INVAL:
+    case ANDES_CCTL_L1D_VA_WB:
+    case ANDES_CCTL_L1D_VA_WBINVAL:
+    case ANDES_CCTL_L1D_VA_LOCK:
+    case ANDES_CCTL_L1D_VA_UNLOCK:
+    case ANDES_CCTL_L1D_IX_INVAL:
+    case ANDES_CCTL_L1D_IX_WB:
+    case ANDES_CCTL_L1D_IX_WBINVAL:
+    case ANDES_CCTL_L1D_WBINVAL_ALL:
+    case ANDES_CCTL_L1D_WB_ALL:
+    case ANDES_CCTL_L1D_INVAL_ALL:
+        c = d;
+        break;
+    case ANDES_CCTL_L1I_VA_INVAL:
+    case ANDES_CCTL_L1I_VA_LOCK:
+    case ANDES_CCTL_L1I_VA_UNLOCK:
+    case ANDES_CCTL_L1I_IX_INVAL:
+        c = i;
+        break;
+    default:
+        return 0;
+    }
+    if (!c->tag) {
+        return 0;
+    }
+
+    switch (cmd) {
+    case ANDES_CCTL_L1D_VA_INVAL:
+    case ANDES_CCTL_L1I_VA_INVAL:
+        andes_cache_cctl_va(env, c, addr, false, true);
+        break;
+    case ANDES_CCTL_L1D_VA_WB:
+        andes_cache_cctl_va(env, c, addr, true, false);
+        break;
+    case ANDES_CCTL_L1D_VA_WBINVAL:
+        andes_cache_cctl_va(env, c, addr, true, true);
+        break;
+    case ANDES_CCTL_L1D_VA_LOCK:
+    case ANDES_CCTL_L1I_VA_LOCK:
+        andes_cache_cctl_lock(env, c, addr, true);
+        break;
+    case ANDES_CCTL_L1D_VA_UNLOCK:
+    case ANDES_CCTL_L1I_VA_UNLOCK:
+        andes_cache_cctl_lock(env, c, addr, false);
+        break;
+    case ANDES_CCTL_L1D_IX_INVAL:
+    case ANDES_CCTL_L1I_IX_INVAL:
+        andes_cache_cctl_ix(env, c, addr, false, true);
+        break;
+    case ANDES_CCTL_L1D_IX_WB:
+        andes_cache_cctl_ix(env, c, addr, true, false);
+        break;
+    case ANDES_CCTL_L1D_IX_WBINVAL:
+        andes_cache_cctl_ix(env, c, addr, true, true);
+        break;
+    case ANDES_CCTL_L1D_WBINVAL_ALL:
+        andes_cache_cctl_all(env, c, true, true);
+        return 0;
+    case ANDES_CCTL_L1D_WB_ALL:
+        andes_cache_cctl_all(env, c, true, false);
+        return 0;
+    case ANDES_CCTL_L1D_INVAL_ALL:
+        andes_cache_cctl_all(env, c, false, true);
+        return 0;
+    }
+    return 1 << c->line_bits;
+}
+
+/*
+ * micm_cfg/mdcm_cfg: 64 << xSET sets of xWAY + 1 ways, with lines of
+ * 4 << xSZ bytes, xSZ == 0 meaning no cache.
+ */
+static void andes_cache_init_l1(AndesCache *c, target_ulong cfg,
+                                target_ulong set_mask, target_ulong way_mask,
+                                target_ulong sz_mask)
+{
+    uint32_t sz = get_field(cfg, sz_mask);
+
+    if (sz == 0) {
+        return;
+    }
+    andes_cache_init(c, 6 + get_field(cfg, set_mask),
+                     get_field(cfg, way_mask) + 1, 2 + sz);
+}
+
+void andes_cache_realize(CPURISCVState *env)
+{
+    static bool l2_done;
+    AndesCacheModel *m;
+    uint64_t val;
+
+    if (!andes_config_bool(ANDES_CONFIG_ID_CPU, "cache-model", &val) || !val) {
+        return;
+    }
+
+    m = g_new0(AndesCacheModel, 1);
+    andes_cache_init_l1(&m->l1i, env->andes_csr.csrno[CSR_MICM_CFG],
+                        MASK_MICM_CFG_ISET, MASK_MICM_CFG_IWAY,
+                        MASK_MICM_CFG_ISZ);
+    andes_cache_init_l1(&m->l1d, env->andes_csr.csrno[CSR_MDCM_CFG],
+                        MASK_MDCM_CFG_DSET, MASK_MDCM_CFG_DWAY,
+                        MASK_MDCM_CFG_DSZ);
+    env->andes_cache = m;
+
+    if (l2_done) {
+        return;
+    }
+    l2_done = true;
+    qemu_spin_init(&andes_l2_lock);
+    if (andes_config_number(ANDES_CONFIG_ID_CPU, "cache-l2-cycles", &val)) {
+        andes_l2_cycles = val;
+    }
+    if (andes_config_number(ANDES_CONFIG_ID_CPU, "cache-mem-cycles", &val)) {
+        andes_mem_cycles = val;
+    }
+    if (andes_config_number(ANDES_CONFIG_ID_CPU, "cache-l2-size", &val) &&
+        val) {
+        uint64_t ways = 16, line = 64;
+
+        andes_config_number(ANDES_CONFIG_ID_CPU, "cache-l2-way", &ways);
+        andes_config_number(ANDES_CONFIG_ID_CPU, "cache-l2-line", &line);
+        if (!is_power_of_2(val) || !is_power_of_2(line) || !ways ||
+            val < ways * line || !is_power_of_2(val / (ways * line))) {
+            error_report("andes-config: invalid L2 cache geometry");
+            exit(1);
+        }
+        andes_cache_init(&andes_l2, ctz64(val / (ways * line)), ways,
+                         ctz64(line));
+    }
+}
+
+void andes_cache_reset(CPURISCVState *env)
+{
+    AndesCacheModel *m = env->andes_cache;
+
+    andes_cache_flush(&m->l1i);
+    andes_cache_flush(&m->l1d);
+    qemu_spin_lock(&andes_l2_lock);
+    andes_cache_flush(&andes_l2);
+    qemu_spin_unlock(&andes_l2_lock);
+}
@@ -0,0 +1,55 @@
+/*
+ * Andes L1I/L1D/L2 cache timing model
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef RISCV_ANDES_CACHE_H
+#define RISCV_ANDES_CACHE_H
+
+#include "cpu.h"
+
+/* Access size in the low bits of the andes_cache_data helper argument */
+#define ANDES_CACHE_SIZE_MASK   0xffff
+#define ANDES_CACHE_STORE       (1 << 16)
+
+/* CCTL commands of mcctlcommand/ucctlcommand */
+enum {
+    ANDES_CCTL_L1D_VA_INVAL = 0,
+    ANDES_CCTL_L1D_VA_WB = 1,
+    ANDES_CCTL_L1D_VA_WBINVAL = 2,
+    ANDES_CCTL_L1D_VA_LOCK = 3,
+    ANDES_CCTL_L1D_VA_UNLOCK = 4,
+    ANDES_CCTL_L1D_WBINVAL_ALL = 6,
+    ANDES_CCTL_L1D_WB_ALL = 7,
+    ANDES_CCTL_L1I_VA_INVAL = 8,
+    ANDES_CCTL_L1I_VA_LOCK = 11,
+    ANDES_CCTL_L1I_VA_UNLOCK = 12,
+    ANDES_CCTL_L1D_IX_INVAL = 16,
+    ANDES_CCTL_L1D_IX_WB = 17,
+    ANDES_CCTL_L1D_IX_WBINVAL = 18,
+    ANDES_CCTL_L1D_INVAL_ALL = 23,
+    ANDES_CCTL_L1I_IX_INVAL = 24,
+};
+
+void andes_cache_realize(CPURISCVState *env);
+void andes_cache_reset(CPURISCVState *env);
+int andes_cache_fetch_line_bits(CPURISCVState *env);
+void andes_cache_access(CPURISCVState *env, vaddr addr, uint32_t len,
+                        bool store);
+target_ulong andes_cache_cctl(CPURISCVState *env, target_ulong cmd,
+                              target_ulong addr);
+
+/* For the accesses that helpers do on behalf of an instruction */
+static inline void andes_cache_data(CPURISCVState *env, vaddr addr,
+                                    uint32_t len, bool store)
+{
+#ifndef CONFIG_USER_ONLY
+    if (unlikely(env->andes_cache)) {
+        andes_cache_access(env, addr, len, store);
+    }
+#endif
+}
+
+#endif
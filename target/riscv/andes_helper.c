@@ -12,7 +12,7 @@
 #include "exec/helper-proto.h"
 #include "fpu/softfloat.h"
 #include "internals.h"
-typedef int (*test_function)(uint8_t a, uint8_t b);
+
 target_ulong helper_andes_v5_bfo_x(target_ulong rd, target_ulong rs1,
                                    target_ulong insn)
 {
@@ -55,88 +55,6 @@ target_ulong helper_andes_v5_bfo_x(target_ulong rd, target_ulong rs1,
     return (target_long)nxrd;
 }
 
-static int andes_v5_fb_x_internal(uint8_t *bytes1, uint8_t *bytes2, int size,
-                             int is_little_endian, test_function test)
-{
-    int i, found;
-
-    found = 0;
-
-    if (is_little_endian) {
-        for (i = 0; i < size; ++i) {
-            if (test(bytes1[i], bytes2[i])) {
-                found = i - size;
-                break;
-            }
-        }
-    } else { /* is_big_endian */
-        for (i = size - 1; i >= 0; --i) {
-            if (test(bytes1[i], bytes2[i])) {
-                found = i - size;
-                break;
-            }
-        }
-    }
-
-    return found;
-}
-
-static int andes_v5_test_match(uint8_t a, uint8_t b)
-{
-    return (a == b);
-}
-
-static int andes_v5_test_mismatch(uint8_t a, uint8_t b)
-{
-    return (a != b);
-}
-
-static int andes_v5_test_zero_mismatch(uint8_t a, uint8_t b)
-{
-    return (a == 0) || (a != b);
-}
-
-target_ulong helper_andes_v5_fb_x(target_ulong rs1, target_ulong rs2,
-                                  target_ulong op)
-{
-    target_ulong rd;
-    uint8_t *pa, *pb;
-    unsigned int size;
-
-    size = sizeof(target_ulong);
-    pa = (uint8_t *)&rs1;
-    pb = (uint8_t *)&rs2;
-    rd = 0;
-
-    switch (op) {
-    case 0x10: /* FFB */
-        /* Each byte in Rs1 is matched with the value in Rs2[7:0].  */
-        memset(pb, *pb, size);
-        rd = andes_v5_fb_x_internal(pa, pb, size, 1, andes_v5_test_match);
-        break;
-    case 0x11: /* FFZMISM */
-        rd = andes_v5_fb_x_internal(pa, pb, size, 1,
-                                    andes_v5_test_zero_mismatch);
-        break;
-    case 0x12: /* FFMISM */
-        rd = andes_v5_fb_x_internal(pa, pb, size, 1, andes_v5_test_mismatch);
-        break;
-    case 0x13: /* FLMISM */
-        /*
-         * tricky!
-         *   # reverse endian to find last
-         *   # patch result
-         */
-        rd = andes_v5_fb_x_internal(pa, pb, size, 0, andes_v5_test_mismatch);
-        break;
-    default:
-        /* helper_raise_exception(env, RISCV_EXCP_ILLEGAL_INST); */
-        break;
-    }
-
-    return rd;
-}
-
 uint64_t helper_andes_nfcvt_bf16_s(CPURISCVState *env, uint64_t rs2)
 {
     float32 frs = check_nanbox_s(env, rs2);
@@ -209,7 +127,7 @@ void helper_andes_v5_hsp_check(CPURISCVState *env, target_ulong val)
 #include "andes_ace_helper.h"
 target_ulong helper_andes_ace(CPURISCVState *env, target_ulong opcode)
 {
-    int ret = qemu_ace_agent_run_insn(env, opcode);
+    int ret = qemu_ace_agent_run_insn_ra(env, opcode, GETPC());
     if (ret != 0) {
         /* wrong ACE instruction seems return RESERVED_INSN(=1), not ILL Insn */
         qemu_printf("Run ace instruction result = %d\n", ret);
@@ -217,3 +135,44 @@ target_ulong helper_andes_ace(CPURISCVState *env, target_ulong opcode)
     }
     return 0;
 }
+
+void helper_andes_ace_decoded(CPURISCVState *env, const void *insn)
+{
+    int ret = qemu_ace_agent_run_decoded(env, insn, GETPC());
+    if (ret != 0) {
+        qemu_printf("Run ace instruction result = %d\n", ret);
+        riscv_raise_exception(env, RISCV_EXCP_ILLEGAL_INST, GETPC());
+    }
+}
+
+static target_ulong do_andes_ace_v2(CPURISCVState *env, uint32_t index,
+                                    uint32_t opcode, target_ulong src0,
+                                    target_ulong src1, target_ulong src2,
+                                    uintptr_t ra)
+{
+    const AceInsnSig *sig = qemu_ace_agent_insn_sig(index);
+    int32_t status = 0;
+    target_ulong ret;
+
+    ret = qemu_ace_agent_exec(env, sig, opcode, src0, src1, src2, &status,
+                              ra);
+    if (status != 0) {
+        qemu_printf("Run ace instruction result = %d\n", status);
+        riscv_raise_exception(env, RISCV_EXCP_ILLEGAL_INST, ra);
+    }
+    return ret;
+}
+
+target_ulong helper_andes_ace_v2(CPURISCVState *env, uint32_t index,
+                                 uint32_t opcode, target_ulong src0,
+                                 target_ulong src1, target_ulong src2)
+{
+    return do_andes_ace_v2(env, index, opcode, src0, src1, src2, GETPC());
+}
+
+target_ulong helper_andes_ace_v2_pure(CPURISCVState *env, uint32_t index,
+                                      uint32_t opcode, target_ulong src0,
+                                      target_ulong src1, target_ulong src2)
+{
+    return do_andes_ace_v2(env, index, opcode, src0, src1, src2, GETPC());
+}
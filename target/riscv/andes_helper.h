@@ -1,5 +1,4 @@
 DEF_HELPER_FLAGS_3(andes_v5_bfo_x, TCG_CALL_NO_RWG, tl, tl, tl, tl)
-DEF_HELPER_FLAGS_3(andes_v5_fb_x, TCG_CALL_NO_RWG, tl, tl, tl, tl)
 DEF_HELPER_FLAGS_2(andes_nfcvt_bf16_s, TCG_CALL_NO_RWG, i64, env, i64)
 DEF_HELPER_FLAGS_2(andes_nfcvt_s_bf16, TCG_CALL_NO_RWG, i64, env, i64)
 DEF_HELPER_5(andes_vfwcvt_s_bf16, void, ptr, ptr, ptr, env, i32)
@@ -42,5 +41,13 @@ DEF_HELPER_6(vqmaccsu_vx_b, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vqmaccsu_vx_h, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vqmaccus_vx_b, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vqmaccus_vx_h, void, ptr, ptr, tl, ptr, env, i32)
-DEF_HELPER_FLAGS_2(andes_ace, TCG_CALL_NO_RWG, tl, env, tl)
+DEF_HELPER_2(andes_ace, tl, env, tl)
+DEF_HELPER_2(andes_ace_decoded, void, env, cptr)
+DEF_HELPER_6(andes_ace_v2, tl, env, i32, i32, tl, tl, tl)
+DEF_HELPER_FLAGS_6(andes_ace_v2_pure, TCG_CALL_NO_WG, tl, env, i32, i32,
+                   tl, tl, tl)
 DEF_HELPER_FLAGS_2(andes_v5_hsp_check, TCG_CALL_NO_RWG, void, env, tl)
+#ifndef CONFIG_USER_ONLY
+DEF_HELPER_FLAGS_2(andes_cache_fetch, TCG_CALL_NO_WG, void, env, tl)
+DEF_HELPER_FLAGS_3(andes_cache_data, TCG_CALL_NO_WG, void, env, tl, i32)
+#endif
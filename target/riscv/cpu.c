@@ -43,6 +43,7 @@
 #include "tcg/tcg.h"
 #include "exec/address-spaces.h"
 #include "exec/ramblock.h"
+#include "andes_cache.h"
 
 /* RISC-V CPU definitions */
 static const char riscv_single_letter_exts[] = "IEMAFDQCPVH";
@@ -477,68 +478,6 @@ static bool get_uint64_from_soc_prop(const char *name, uint64_t *val)
     return true;
 }
 
-static uint64_t memory_region_local_mem_read(void *opaque,
-                                              hwaddr addr, unsigned size)
-{
-    MemoryRegion *mr = opaque;
-    uint64_t data = (uint64_t)~0;
-
-    switch (size) {
-    case 1:
-        data = *(uint8_t *)(mr->ram_block->host + addr);
-        break;
-    case 2:
-        data = *(uint16_t *)(mr->ram_block->host + addr);
-        break;
-    case 4:
-        data = *(uint32_t *)(mr->ram_block->host + addr);
-        break;
-    case 8:
-        data = *(uint64_t *)(mr->ram_block->host + addr);
-        break;
-    }
-
-    return data;
-}
-
-static void memory_region_local_mem_write(void *opaque, hwaddr addr,
-                                           uint64_t data, unsigned size)
-{
-    MemoryRegion *mr = opaque;
-
-    switch (size) {
-    case 1:
-        *(uint8_t *)(mr->ram_block->host + addr) = (uint8_t)data;
-        break;
-    case 2:
-        *(uint16_t *)(mr->ram_block->host + addr) = (uint16_t)data;
-        break;
-    case 4:
-        *(uint32_t *)(mr->ram_block->host + addr) = (uint32_t)data;
-        break;
-    case 8:
-        *(uint64_t *)(mr->ram_block->host + addr) = data;
-        break;
-    }
-}
-
-static const MemoryRegionOps local_mem_ops = {
-    .read = memory_region_local_mem_read,
-    .write = memory_region_local_mem_write,
-    .endianness = DEVICE_LITTLE_ENDIAN,
-    .valid = {
-        .min_access_size = 1,
-        .max_access_size = 8,
-        .unaligned = true,
-        .accepts = NULL,
-    },
-    .impl = {
-        .min_access_size = 1,
-        .max_access_size = 8,
-        .unaligned = true,
-    },
-};
-
 static void andes_cpu_lm_init(Object *obj)
 {
     CPURISCVState *env = &RISCV_CPU(obj)->env;
@@ -573,6 +512,11 @@ static void andes_cpu_lm_init(Object *obj)
     env->mask_dlm = g_new(MemoryRegion, 1);
 }
 
+/*
+ * The ILM and DLM of each hart are its own RAM, mapped over system memory
+ * only in the address space of that hart.  Code run from the ILM is then
+ * translated into ordinary TBs, and loads and stores hit the TLB directly.
+ */
 static void andes_cpu_lm_realize(DeviceState *dev)
 {
     CPURISCVState *env = &RISCV_CPU(dev)->env;
@@ -583,9 +527,6 @@ static void andes_cpu_lm_realize(DeviceState *dev)
             g_strdup_printf("%s%d", "riscv.andes.ae350.ilm", lm_num);
         memory_region_init_ram(env->mask_ilm, OBJECT(dev), ilm_name,
                                env->ilm_size, &error_fatal);
-        /* local memory operation */
-        env->mask_ilm->ops = &local_mem_ops;
-        env->mask_ilm->opaque = env->mask_ilm;
 
         if (env->ilm_default_enable) {
             memory_region_add_subregion_overlap(env->cpu_as_root, env->ilm_base,
@@ -597,9 +538,6 @@ static void andes_cpu_lm_realize(DeviceState *dev)
             g_strdup_printf("%s%d", "riscv.andes.ae350.dlm", lm_num);
         memory_region_init_ram(env->mask_dlm, OBJECT(dev), dlm_name,
                                env->dlm_size, &error_fatal);
-        /* local memory operation */
-        env->mask_dlm->ops = &local_mem_ops;
-        env->mask_dlm->opaque = env->mask_dlm;
 
         if (env->dlm_default_enable) {
             memory_region_add_subregion_overlap(env->cpu_as_root, env->dlm_base,
@@ -1788,6 +1726,7 @@ static void riscv_cpu_reset_hold(Object *obj)
         env->pmp_state.addr[i].ea = 0;
     }
     env->pmp_state.num_rules = 0;
+    env->pmp_state.seg_valid = false;
 
     bool locked = false;
     if (!qemu_mutex_iothread_locked()) {
@@ -1864,6 +1803,10 @@ static void riscv_cpu_reset_hold(Object *obj)
         riscv_trigger_reset_hold(env);
     }
 
+    if (env->andes_cache) {
+        andes_cache_reset(env);
+    }
+
     if (kvm_enabled()) {
         kvm_riscv_reset_vcpu(cpu);
     }
@@ -2033,6 +1976,13 @@ static void riscv_cpu_realize(DeviceState *dev, Error **errp)
     qemu_init_vcpu(cs);
     cpu_reset(cs);
 
+#ifndef CONFIG_USER_ONLY
+    /* The cache geometry comes from micm_cfg/mdcm_cfg, set up by the reset */
+    if (tcg_enabled() && is_andes_riscv_cpu_type(OBJECT(dev))) {
+        andes_cache_realize(&cpu->env);
+    }
+#endif
+
     /*
      * Move below function from above to here, because some Andes CSRs
      * will check another relative CSR bit for confirm it whether should
@@ -2443,6 +2393,8 @@ const PropertyInfo prop_pmu_num = {
 Property riscv_cpu_options[] = {
     DEFINE_PROP_UINT32("pmu-mask", RISCVCPU, cfg.pmu_mask, MAKE_64BIT_MASK(3, 16)),
     {.name = "pmu-num", .info = &prop_pmu_num}, /* Deprecated */
+    DEFINE_PROP_BOOL("pmu-exact", RISCVCPU, cfg.pmu_exact, false),
+    DEFINE_PROP_BOOL("x-superblocks", RISCVCPU, cfg.superblocks, false),
 
     DEFINE_PROP_BOOL("mmu", RISCVCPU, cfg.mmu, true),
     DEFINE_PROP_BOOL("pmp", RISCVCPU, cfg.pmp, true),
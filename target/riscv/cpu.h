@@ -53,8 +53,9 @@ typedef struct CPUArchState CPURISCVState;
 /*
  * RISC-V-specific extra insn start words:
  * 1: Original instruction opcode
+ * 2: Exact PMU counts of the insns before this one in the TB, see pmu.h
  */
-#define TARGET_INSN_START_EXTRA_WORDS 1
+#define TARGET_INSN_START_EXTRA_WORDS 2
 
 #define RV(x) ((target_ulong)1 << (x - 'A'))
 
@@ -124,6 +125,7 @@ typedef enum {
 #define RV_VLEN_MAX 1024
 #define RV_MAX_MHPMEVENTS 32
 #define RV_MAX_MHPMCOUNTERS 32
+#define RISCV_SUPERBLOCK_HEAT_SIZE 1024
 
 FIELD(VTYPE, VLMUL, 0, 3)
 FIELD(VTYPE, VSEW, 3, 3)
@@ -146,6 +148,16 @@ typedef struct PMUCTRState {
     target_ulong irq_overflow_left;
 } PMUCTRState;
 
+/* Guest memory span handed out to an ACE agent, see ACE_GET_MEM_SPAN */
+typedef struct AceMemSpan {
+    void *host;
+    uint64_t vaddr;
+    uint32_t size;
+    uint32_t access;
+    /* bounce buffer, NULL when host points directly into guest RAM */
+    uint8_t *bounce;
+} AceMemSpan;
+
 struct CPUArchState {
     target_ulong gpr[32];
     target_ulong gprh[32]; /* 64 top bits of the 128-bit registers */
@@ -339,6 +351,10 @@ struct CPUArchState {
     /* PMU event selector configured values for RV32 */
     target_ulong mhpmeventh_val[RV_MAX_MHPMEVENTS];
 
+    /* "pmu-exact": instructions retired, and the counts of the current TB */
+    uint64_t pmu_exact_insns;
+    uint32_t pmu_exact_tb;
+
     target_ulong sscratch;
     target_ulong mscratch;
 
@@ -439,6 +455,14 @@ struct CPUArchState {
     /* Andes ACE agent symbols */
     AceAgentReg ace_agent_register;
     AceAgentRunInsn ace_agent_run_insn;
+    /* this hart's agent context, from ace_agent_context_new() */
+    void *ace_agent_ctx;
+    /* host return address of the helper running the agent, for faults */
+    uintptr_t ace_ra;
+    AceMemSpan ace_mem_span[ACE_MEM_SPAN_MAX];
+
+    /* "x-superblocks": runs of the tier-1 TBs, by a hash of their pc */
+    uint16_t superblock_heat[RISCV_SUPERBLOCK_HEAT_SIZE];
 
 #ifndef CONFIG_USER_ONLY
     MemoryRegion *cpu_as_root;
@@ -451,6 +475,9 @@ struct CPUArchState {
     uint32_t dlm_size;
     bool ilm_default_enable;
     bool dlm_default_enable;
+
+    /* Cache timing model, NULL unless enabled with -andes-config */
+    struct AndesCacheModel *andes_cache;
 #endif
 
 };
@@ -792,14 +819,31 @@ enum {
 enum riscv_pmu_event_idx {
     RISCV_PMU_EVENT_HW_CPU_CYCLES = 0x01,
     RISCV_PMU_EVENT_HW_INSTRUCTIONS = 0x02,
+    RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS = 0x05,
     RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS = 0x10019,
     RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS = 0x1001B,
     RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS = 0x10021,
     /* Andes pmnds event */
     RISCV_PMU_EVENT_ANDES_CPU_CYCLES = 0x10,
     RISCV_PMU_EVENT_ANDES_INSTRUCTIONS = 0x20,
+    RISCV_PMU_EVENT_ANDES_INT_LOAD = 0x30,
+    RISCV_PMU_EVENT_ANDES_INT_STORE = 0x40,
+    RISCV_PMU_EVENT_ANDES_COND_BRANCH = 0x80,
     RISCV_PMU_EVENT_ANDES_DTLB_MISS = 0x141,
     RISCV_PMU_EVENT_ANDES_ITLB_MISS = 0x121,
+    RISCV_PMU_EVENT_ANDES_ICACHE_ACCESS = 0x31,
+    RISCV_PMU_EVENT_ANDES_ICACHE_MISS = 0x41,
+    RISCV_PMU_EVENT_ANDES_DCACHE_ACCESS = 0x51,
+    RISCV_PMU_EVENT_ANDES_DCACHE_MISS = 0x61,
+    RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_ACCESS = 0x71,
+    RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_MISS = 0x81,
+    RISCV_PMU_EVENT_ANDES_DCACHE_STORE_ACCESS = 0x91,
+    RISCV_PMU_EVENT_ANDES_DCACHE_STORE_MISS = 0xa1,
+    RISCV_PMU_EVENT_ANDES_DCACHE_WB = 0xb1,
+    RISCV_PMU_EVENT_ANDES_ICACHE_FILL_CYCLES = 0xc1,
+    RISCV_PMU_EVENT_ANDES_DCACHE_FILL_CYCLES = 0xd1,
+    RISCV_PMU_EVENT_ANDES_UNCACHED_FETCH = 0xe1,
+    RISCV_PMU_EVENT_ANDES_UNCACHED_LOAD = 0xf1,
 };
 
 /* used by tcg/tcg-cpu.c*/
@@ -140,6 +140,8 @@ struct RISCVCPUConfig {
     bool ext_XAndesCodenseOps;
 
     uint32_t pmu_mask;
+    bool pmu_exact;
+    bool superblocks;
     char *priv_spec;
     char *user_spec;
     char *bext_spec;
@@ -96,6 +96,17 @@ void cpu_get_tb_cpu_state(CPURISCVState *env, vaddr *pc,
         flags = FIELD_DP32(flags, TB_FLAGS, VMA,
                            FIELD_EX64(env->vtype, VTYPE, VMA));
         flags = FIELD_DP32(flags, TB_FLAGS, VSTART_EQ_ZERO, env->vstart == 0);
+        /*
+         * A shorter vl, typically the last iteration of a strip-mined loop,
+         * is recorded in cs_base so that the unmasked ops can still be
+         * expanded with GVEC over the first vl elements.  Only lengths
+         * GVEC can operate on are recorded, which bounds the number of
+         * TB variants.
+         */
+        if (env->vstart == 0 && env->vl != 0 && env->vl < vlmax &&
+            ((env->vl << sew) % 16) == 0) {
+            *cs_base = env->vl;
+        }
     } else {
         flags = FIELD_DP32(flags, TB_FLAGS, VILL, 1);
     }
@@ -805,13 +805,15 @@ static int write_vcsr(CPURISCVState *env, int csrno, target_ulong val)
 }
 
 /* User Timers and Counters */
-static target_ulong get_ticks(bool shift)
+static target_ulong get_ticks(CPURISCVState *env, bool shift)
 {
     int64_t val;
     target_ulong result;
 
 #if !defined(CONFIG_USER_ONLY)
-    if (icount_enabled()) {
+    if (env_archcpu(env)->cfg.pmu_exact) {
+        val = env->pmu_exact_insns;
+    } else if (icount_enabled()) {
         val = icount_get();
     } else {
         val = cpu_get_host_ticks();
@@ -846,13 +848,13 @@ static RISCVException read_timeh(CPURISCVState *env, int csrno,
 
 static int read_hpmcounter(CPURISCVState *env, int csrno, target_ulong *val)
 {
-    *val = get_ticks(false);
+    *val = get_ticks(env, false);
     return RISCV_EXCP_NONE;
 }
 
 static int read_hpmcounterh(CPURISCVState *env, int csrno, target_ulong *val)
 {
-    *val = get_ticks(true);
+    *val = get_ticks(env, true);
     return RISCV_EXCP_NONE;
 }
 
@@ -915,7 +917,7 @@ static int write_mhpmcounter(CPURISCVState *env, int csrno, target_ulong val)
     counter->mhpmcounter_val = val;
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        counter->mhpmcounter_prev = get_ticks(false);
+        counter->mhpmcounter_prev = get_ticks(env, false);
         if (ctr_idx > 2) {
             if (riscv_cpu_mxl(env) == MXL_RV32) {
                 mhpmctr_val = mhpmctr_val |
@@ -942,7 +944,7 @@ static int write_mhpmcounterh(CPURISCVState *env, int csrno, target_ulong val)
     mhpmctr_val = mhpmctr_val | (mhpmctrh_val << 32);
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        counter->mhpmcounterh_prev = get_ticks(true);
+        counter->mhpmcounterh_prev = get_ticks(env, true);
         if (ctr_idx > 2) {
             riscv_pmu_setup_timer(env, mhpmctr_val, ctr_idx);
         }
@@ -983,7 +985,7 @@ static RISCVException riscv_pmu_read_ctr(CPURISCVState *env, target_ulong *val,
      */
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        *val = get_ticks(upper_half) - ctr_prev + ctr_val;
+        *val = get_ticks(env, upper_half) - ctr_prev + ctr_val;
     } else {
         *val = ctr_val;
     }
@@ -14,6 +14,7 @@
 #include "csr_andes.h"
 #include "exec/address-spaces.h"
 #include "qemu/andes-config.h"
+#include "andes_cache.h"
 
 static RISCVException any(CPURISCVState *env,
                           int csrno)
@@ -427,6 +428,26 @@ static RISCVException write_csr(CPURISCVState *env,
     return RISCV_EXCP_NONE;
 }
 
+/*
+ * With the cache model, run the CCTL operation and move the begin address
+ * on to the next line, as the hardware does for the VA and index commands.
+ */
+static RISCVException write_cctlcommand(CPURISCVState *env, int csrno,
+                                        target_ulong val)
+{
+    env->andes_csr.csrno[csrno] = val;
+#ifndef CONFIG_USER_ONLY
+    if (env->andes_cache) {
+        int begin = csrno == CSR_MCCTLCOMMAND ? CSR_MCCTLBEGINADDR :
+                                                CSR_UCCTLBEGINADDR;
+
+        env->andes_csr.csrno[begin] +=
+            andes_cache_cctl(env, val, env->andes_csr.csrno[begin]);
+    }
+#endif
+    return RISCV_EXCP_NONE;
+}
+
 static RISCVException write_mecc_code(CPURISCVState *env, int csrno,
                                       target_ulong val)
 {
@@ -823,6 +844,7 @@ static RISCVException write_lmb(CPURISCVState *env,
     uint64_t enable = val & 0x1;
     bool ilm_mapped, dlm_mapped;
     bool locked = false;
+    bool remapped = false;
     if (!qemu_mutex_iothread_locked()) {
         locked = true;
         qemu_mutex_lock_iothread();
@@ -832,8 +854,10 @@ static RISCVException write_lmb(CPURISCVState *env,
         if (enable && !ilm_mapped) {
             memory_region_add_subregion_overlap(env->cpu_as_root,
                                 env->ilm_base, env->mask_ilm, 1);
+            remapped = true;
         } else if (!enable && ilm_mapped) {
             memory_region_del_subregion(env->cpu_as_root, env->mask_ilm);
+            remapped = true;
         }
         env->andes_csr.csrno[csrno] = env->ilm_base | (val & 0xf);
     }
@@ -842,12 +866,20 @@ static RISCVException write_lmb(CPURISCVState *env,
         if (enable && !dlm_mapped) {
             memory_region_add_subregion_overlap(env->cpu_as_root,
                                 env->dlm_base, env->mask_dlm, 1);
+            remapped = true;
         } else if (!enable && dlm_mapped) {
             memory_region_del_subregion(env->cpu_as_root, env->mask_dlm);
+            remapped = true;
         }
         env->andes_csr.csrno[csrno] = env->dlm_base | (val & 0xf);
     }
-    tlb_flush(env_cpu(env));
+    /*
+     * TBs are keyed by ram address and stay valid across the remap, only
+     * the translations that bypassed the MMU for the old mapping must go.
+     */
+    if (remapped) {
+        tlb_flush(env_cpu(env));
+    }
     if (locked) {
         qemu_mutex_unlock_iothread();
     }
@@ -1198,7 +1230,8 @@ riscv_csr_operations andes_csr_ops[CSR_TABLE_SIZE] = {
     [CSR_MCACHE_CTL]     = { "mcache_ctl",        isz_dsz, read_csr,
                                                            write_mcache_ctl  },
     [CSR_MCCTLBEGINADDR] = { "mcctlbeginaddr",    mcctl, read_csr, write_csr },
-    [CSR_MCCTLCOMMAND]   = { "mcctlcommand",      mcctl, read_csr, write_csr },
+    [CSR_MCCTLCOMMAND]   = { "mcctlcommand",      mcctl, read_csr,
+                                                         write_cctlcommand },
     [CSR_MCCTLDATA]      = { "mcctldata",         mcctl, read_csr, write_csr },
     [CSR_MPPIB]          = { "mppib",             ppi, read_csr, write_mppib },
     [CSR_MFIOB]          = { "mfiob",             fio, read_csr, write_mfiob },
@@ -1314,7 +1347,8 @@ riscv_csr_operations andes_csr_ops[CSR_TABLE_SIZE] = {
                                                          write_ucode          },
     [CSR_UDCAUSE]        = { "udcause",           any,   read_csr, write_csr  },
     [CSR_UCCTLBEGINADDR] = { "ucctlbeginaddr",    ucctl, read_csr, write_csr  },
-    [CSR_UCCTLCOMMAND]   = { "ucctlcommand",      ucctl, read_csr, write_csr  },
+    [CSR_UCCTLCOMMAND]   = { "ucctlcommand",      ucctl, read_csr,
+                                                         write_cctlcommand },
     [CSR_WFE]            = { "wfe",               any,   read_csr, write_csr  },
     [CSR_SLEEPVALUE]     = { "sleepvalue",        any,   read_csr, write_csr  },
     [CSR_TXEVT]          = { "csr_txevt",         any,   read_csr, write_csr  },
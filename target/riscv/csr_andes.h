@@ -113,6 +113,8 @@ typedef void (*fp_spec_csr_init_fn)(AndesCsr *);
 #define V5_MMISC_CTL_NON_BLOCKING           8
 
 /* mcache_ctl */
+#define V5_MCACHE_CTL_IC_EN                 0
+#define V5_MCACHE_CTL_DC_EN                 1
 #define V5_MCACHE_CTL_IC_FIRST_WORD         11
 #define V5_MCACHE_CTL_DC_FIRST_WORD         12
 #define V5_MCACHE_CTL_DC_COHEN              19
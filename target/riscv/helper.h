@@ -1,6 +1,9 @@
 /* Exceptions */
 DEF_HELPER_2(raise_exception, noreturn, env, i32)
 
+/* Superblocks */
+DEF_HELPER_2(superblock_promote, noreturn, env, ptr)
+
 /* Floating Point - rounding mode */
 DEF_HELPER_FLAGS_2(set_rounding_mode, TCG_CALL_NO_WG, void, env, i32)
 DEF_HELPER_FLAGS_2(set_rounding_mode_chkfrm, TCG_CALL_NO_WG, void, env, i32)
@@ -137,6 +140,9 @@ DEF_HELPER_1(tlb_flush_all, void, env)
 /* Native Debug */
 DEF_HELPER_1(itrigger_match, void, env)
 DEF_HELPER_1(itrigger_fire, void, env)
+/* Exact PMU counting */
+DEF_HELPER_FLAGS_2(pmu_exact_count, TCG_CALL_NO_WG, void, env, i32)
+DEF_HELPER_FLAGS_2(pmu_exact_unwind, TCG_CALL_NO_WG, void, env, i32)
 #endif
 
 /* Hypervisor functions */
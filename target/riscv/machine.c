@@ -334,6 +334,24 @@ static const VMStateDescription vmstate_pmu_ctr_state = {
     }
 };
 
+static bool pmu_exact_needed(void *opaque)
+{
+    RISCVCPU *cpu = opaque;
+
+    return cpu->cfg.pmu_exact;
+}
+
+static const VMStateDescription vmstate_pmu_exact = {
+    .name = "cpu/pmu_exact",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = pmu_exact_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT64(env.pmu_exact_insns, RISCVCPU),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
 static bool jvt_needed(void *opaque)
 {
     RISCVCPU *cpu = opaque;
@@ -425,6 +443,7 @@ const VMStateDescription vmstate_riscv_cpu = {
         &vmstate_debug,
         &vmstate_smstateen,
         &vmstate_jvt,
+        &vmstate_pmu_exact,
         NULL
     }
 };
@@ -39,6 +39,19 @@ void helper_raise_exception(CPURISCVState *env, uint32_t exception)
     riscv_raise_exception(env, exception, 0);
 }
 
+/*
+ * The fall-through of the TB @tb has got hot: drop the TB, so that its pc
+ * is translated again as a superblock, and leave it.  The branch ending
+ * the TB has completed and the pc points past it.
+ */
+void helper_superblock_promote(CPURISCVState *env, void *tb)
+{
+    mmap_lock();
+    tb_phys_invalidate(tb, -1);
+    mmap_unlock();
+    cpu_loop_exit_noexc(env_cpu(env));
+}
+
 target_ulong helper_csrr(CPURISCVState *env, int csr)
 {
     /*
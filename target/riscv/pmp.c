@@ -148,6 +148,7 @@ void pmp_unlock_entries(CPURISCVState *env)
     for (i = 0; i < pmp_num; i++) {
         env->pmp_state.pmp[i].cfg_reg &= ~(PMP_LOCK | PMP_AMATCH);
     }
+    env->pmp_state.seg_valid = false;
 }
 
 static void pmp_decode_napot(target_ulong a, target_ulong *sa,
@@ -211,6 +212,7 @@ void pmp_update_rule_addr(CPURISCVState *env, uint32_t pmp_index)
 
     env->pmp_state.addr[pmp_index].sa = sa;
     env->pmp_state.addr[pmp_index].ea = ea;
+    env->pmp_state.seg_valid = false;
 }
 
 void pmp_update_rule_nums(CPURISCVState *env)
@@ -225,21 +227,93 @@ void pmp_update_rule_nums(CPURISCVState *env)
             env->pmp_state.num_rules++;
         }
     }
+    env->pmp_state.seg_valid = false;
 }
 
-static int pmp_is_in_range(CPURISCVState *env, int pmp_index,
-                           target_ulong addr)
+static int pmp_cmp_addr(const void *a, const void *b)
 {
-    int result = 0;
+    target_ulong x = *(const target_ulong *)a;
+    target_ulong y = *(const target_ulong *)b;
 
-    if ((addr >= env->pmp_state.addr[pmp_index].sa) &&
-        (addr <= env->pmp_state.addr[pmp_index].ea)) {
-        result = 1;
-    } else {
-        result = 0;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Split the address space at every active entry boundary and record the
+ * highest priority entry covering each piece.  Coverage is constant
+ * between two boundaries, so checking the start of each piece is enough.
+ */
+static void pmp_build_segs(CPURISCVState *env)
+{
+    pmp_table_t *t = &env->pmp_state;
+    target_ulong bounds[PMP_MAX_SEGS];
+    int n = 0;
+    int i, j, owner;
+
+    bounds[n++] = 0;
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        if (pmp_get_a_field(t->pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
+            continue;
+        }
+        bounds[n++] = t->addr[i].sa;
+        if (t->addr[i].ea != (target_ulong)-1) {
+            bounds[n++] = t->addr[i].ea + 1;
+        }
+    }
+    qsort(bounds, n, sizeof(bounds[0]), pmp_cmp_addr);
+
+    t->num_segs = 0;
+    for (j = 0; j < n; j++) {
+        if (j && bounds[j] == bounds[j - 1]) {
+            continue;
+        }
+        owner = -1;
+        for (i = 0; i < MAX_RISCV_PMPS; i++) {
+            if (pmp_get_a_field(t->pmp[i].cfg_reg) != PMP_AMATCH_OFF &&
+                bounds[j] >= t->addr[i].sa && bounds[j] <= t->addr[i].ea) {
+                owner = i;
+                break;
+            }
+        }
+        if (t->num_segs && t->seg[t->num_segs - 1].index == owner) {
+            continue;
+        }
+        t->seg[t->num_segs].sa = bounds[j];
+        t->seg[t->num_segs].index = owner;
+        t->num_segs++;
     }
+    t->seg_valid = true;
+}
 
-    return result;
+/* Return the segment containing addr */
+static uint32_t pmp_find_seg(CPURISCVState *env, target_ulong addr)
+{
+    pmp_table_t *t = &env->pmp_state;
+    uint32_t lo = 0, hi;
+
+    if (!t->seg_valid) {
+        pmp_build_segs(env);
+    }
+    /* seg[0].sa is 0, so the answer is the last segment with sa <= addr */
+    hi = t->num_segs - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (t->seg[mid].sa <= addr) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+/* Last address of a segment */
+static target_ulong pmp_seg_end(CPURISCVState *env, uint32_t seg)
+{
+    if (seg + 1 == env->pmp_state.num_segs) {
+        return (target_ulong)-1;
+    }
+    return env->pmp_state.seg[seg + 1].sa - 1;
 }
 
 /*
@@ -310,9 +384,8 @@ bool pmp_hart_has_privs(CPURISCVState *env, target_ulong addr,
                         pmp_priv_t *allowed_privs, target_ulong mode)
 {
     int i = 0;
+    int last = 0;
     int pmp_size = 0;
-    target_ulong s = 0;
-    target_ulong e = 0;
 
     /* Short cut if no rules */
     if (0 == pmp_get_num_rules(env)) {
@@ -335,20 +408,19 @@ bool pmp_hart_has_privs(CPURISCVState *env, target_ulong addr,
 
     /*
      * 1.10 draft priv spec states there is an implicit order
-     * from low to high
+     * from low to high.  The access matches the highest priority entry
+     * containing either end of it, and is only allowed if that entry
+     * contains both ends, i.e. both ends lie in segments of that entry.
      */
-    for (i = 0; i < MAX_RISCV_PMPS; i++) {
-        s = pmp_is_in_range(env, i, addr);
-        e = pmp_is_in_range(env, i, addr + pmp_size - 1);
-
-        /* partially inside */
-        if ((s + e) == 1) {
-            qemu_log_mask(LOG_GUEST_ERROR,
-                          "pmp violation - access is partially inside\n");
-            *allowed_privs = 0;
-            return false;
-        }
-
+    i = env->pmp_state.seg[pmp_find_seg(env, addr)].index;
+    last = env->pmp_state.seg[pmp_find_seg(env, addr + pmp_size - 1)].index;
+    if (i != last) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "pmp violation - access is partially inside\n");
+        *allowed_privs = 0;
+        return false;
+    }
+    if (i >= 0) {
         /* fully inside */
         const uint8_t a_field =
             pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
@@ -363,7 +435,7 @@ bool pmp_hart_has_privs(CPURISCVState *env, target_ulong addr,
             (env->pmp_state.pmp[i].cfg_reg & PMP_WRITE) |
             ((env->pmp_state.pmp[i].cfg_reg & PMP_EXEC) >> 2);
 
-        if (((s + e) == 2) && (PMP_AMATCH_OFF != a_field)) {
+        if (PMP_AMATCH_OFF != a_field) {
             /*
              * If the PMP entry is not off and the address is in range,
              * do the priv check
@@ -632,15 +704,13 @@ target_ulong mseccfg_csr_read(CPURISCVState *env)
  */
 target_ulong pmp_get_tlb_size(CPURISCVState *env, target_ulong addr)
 {
-    target_ulong pmp_sa;
-    target_ulong pmp_ea;
     target_ulong tlb_sa = addr & ~(TARGET_PAGE_SIZE - 1);
     target_ulong tlb_ea = tlb_sa + TARGET_PAGE_SIZE - 1;
     target_ulong ilm_sa = env->ilm_base;
     target_ulong ilm_ea = env->ilm_base + env->ilm_size - 1;
     target_ulong dlm_sa = env->dlm_base;
     target_ulong dlm_ea = env->dlm_base + env->dlm_size - 1;
-    int i;
+    uint32_t seg;
 
     /*
      * If PMP is not supported or there are no PMP rules, the TLB page will not
@@ -651,30 +721,23 @@ target_ulong pmp_get_tlb_size(CPURISCVState *env, target_ulong addr)
         return TARGET_PAGE_SIZE;
     }
 
-    for (i = 0; i < MAX_RISCV_PMPS; i++) {
-        if (pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
-            continue;
-        }
-
-        pmp_sa = env->pmp_state.addr[i].sa;
-        pmp_ea = env->pmp_state.addr[i].ea;
-
-        /*
-         * Only the first PMP entry that covers (whole or partial of) the TLB
-         * page really matters:
-         * If it covers the whole TLB page, set the size to TARGET_PAGE_SIZE,
-         * since the following PMP entries have lower priority and will not
-         * affect the permissions of the page.
-         * If it only covers partial of the TLB page, set the size to 1 since
-         * the allowed permissions of the region may be different from other
-         * region of the page.
-         */
-        if (pmp_sa <= tlb_sa && pmp_ea >= tlb_ea) {
-            return TARGET_PAGE_SIZE;
-        } else if ((pmp_sa >= tlb_sa && pmp_sa <= tlb_ea) ||
-                   (pmp_ea >= tlb_sa && pmp_ea <= tlb_ea)) {
-            return 1;
-        }
+    /*
+     * Only the first PMP entry that covers (whole or partial of) the TLB
+     * page really matters:
+     * If it covers the whole TLB page, the page lies in a single segment
+     * owned by it, set the size to TARGET_PAGE_SIZE, since the following
+     * PMP entries have lower priority and will not affect the permissions
+     * of the page.
+     * If it only covers partial of the TLB page, the page spans several
+     * segments, set the size to 1 since the allowed permissions of the
+     * region may be different from other region of the page.
+     */
+    seg = pmp_find_seg(env, tlb_sa);
+    if (pmp_seg_end(env, seg) < tlb_ea) {
+        return 1;
+    }
+    if (env->pmp_state.seg[seg].index >= 0) {
+        return TARGET_PAGE_SIZE;
     }
 
     if (env->andes_csr.csrno[CSR_MILMB] & 0x1) {
@@ -57,10 +57,26 @@ typedef struct {
     target_ulong ea;
 } pmp_addr_t;
 
+/*
+ * The address space split into segments, each owned by the highest
+ * priority active entry covering it (-1 if none).  A segment runs from sa
+ * to the sa of the next one.
+ */
+typedef struct {
+    target_ulong sa;
+    int index;
+} pmp_seg_t;
+
+#define PMP_MAX_SEGS (2 * MAX_RISCV_PMPS + 1)
+
 typedef struct {
     pmp_entry_t pmp[MAX_RISCV_PMPS];
     pmp_addr_t  addr[MAX_RISCV_PMPS];
     uint32_t num_rules;
+    /* Lookup table, rebuilt on demand after pmpcfg/pmpaddr changes */
+    pmp_seg_t seg[PMP_MAX_SEGS];
+    uint32_t num_segs;
+    bool seg_valid;
 } pmp_table_t;
 
 void pmpcfg_csr_write(CPURISCVState *env, uint32_t reg_index,
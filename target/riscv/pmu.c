@@ -24,6 +24,7 @@
 #include "sysemu/cpu-timers.h"
 #include "sysemu/device_tree.h"
 #include "qemu/andes-config.h"
+#include "exec/helper-proto.h"
 
 static uint64_t riscv_timebase_freq = 1000000000; /* 1Ghz */
 
@@ -36,7 +37,7 @@ static uint64_t riscv_timebase_freq = 1000000000; /* 1Ghz */
  */
 void riscv_pmu_generate_fdt_node(void *fdt, uint32_t cmask, char *pmu_name)
 {
-    uint32_t fdt_event_ctr_map[15] = {};
+    uint32_t fdt_event_ctr_map[18] = {};
 
    /*
     * The event encoding is specified in the SBI specification
@@ -74,6 +75,11 @@ void riscv_pmu_generate_fdt_node(void *fdt, uint32_t cmask, char *pmu_name)
    fdt_event_ctr_map[13] = cpu_to_be32(0x00010021);
    fdt_event_ctr_map[14] = cpu_to_be32(cmask);
 
+   /* SBI_PMU_HW_BRANCH_INSTRUCTIONS: 0x05 : type(0x00), with "pmu-exact" */
+   fdt_event_ctr_map[15] = cpu_to_be32(0x00000005);
+   fdt_event_ctr_map[16] = cpu_to_be32(0x00000005);
+   fdt_event_ctr_map[17] = cpu_to_be32(cmask);
+
    /* This a OpenSBI specific DT property documented in OpenSBI docs */
    qemu_fdt_setprop(fdt, pmu_name, "riscv,event-to-mhpmcounters",
                     fdt_event_ctr_map, sizeof(fdt_event_ctr_map));
@@ -150,12 +156,14 @@ static void riscv_pmu_handle_andes_pmovi_interrupt(CPURISCVState *env,
     }
 }
 
-static int riscv_pmu_incr_ctr_rv32(RISCVCPU *cpu, uint32_t ctr_idx)
+static int riscv_pmu_incr_ctr_rv32(RISCVCPU *cpu, uint32_t ctr_idx,
+                                   int64_t delta)
 {
     CPURISCVState *env = &cpu->env;
     target_ulong max_val = UINT32_MAX;
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
     bool virt_on = env->virt_enabled;
+    uint64_t old, new;
 
     if (!riscv_pmu_has_andes_pmnds(cpu)) {
         /* Privilege mode filtering */
@@ -173,37 +181,35 @@ static int riscv_pmu_incr_ctr_rv32(RISCVCPU *cpu, uint32_t ctr_idx)
         }
     }
 
-    /* Handle the overflow scenario */
-    if (counter->mhpmcounter_val == max_val) {
-        if (counter->mhpmcounterh_val == max_val) {
-            counter->mhpmcounter_val = 0;
-            counter->mhpmcounterh_val = 0;
-
-            if (riscv_pmu_has_andes_pmnds(cpu)) {
-                riscv_pmu_handle_andes_pmovi_interrupt(env, ctr_idx);
-            } else {
-                /* Generate interrupt only if OF bit is clear */
-                if (!(env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_OF)) {
-                    env->mhpmeventh_val[ctr_idx] |= MHPMEVENTH_BIT_OF;
-                    riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
-                }
-            }
+    old = deposit64(counter->mhpmcounter_val & max_val, 32, 32,
+                    counter->mhpmcounterh_val);
+    new = old + delta;
+    counter->mhpmcounter_val = (uint32_t)new;
+    counter->mhpmcounterh_val = new >> 32;
+
+    /* Handle the overflow scenario, "pmu-exact" also takes counts back */
+    if (delta > 0 && new < old) {
+        if (riscv_pmu_has_andes_pmnds(cpu)) {
+            riscv_pmu_handle_andes_pmovi_interrupt(env, ctr_idx);
         } else {
-            counter->mhpmcounterh_val++;
+            /* Generate interrupt only if OF bit is clear */
+            if (!(env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_OF)) {
+                env->mhpmeventh_val[ctr_idx] |= MHPMEVENTH_BIT_OF;
+                riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
+            }
         }
-    } else {
-        counter->mhpmcounter_val++;
     }
 
     return 0;
 }
 
-static int riscv_pmu_incr_ctr_rv64(RISCVCPU *cpu, uint32_t ctr_idx)
+static int riscv_pmu_incr_ctr_rv64(RISCVCPU *cpu, uint32_t ctr_idx,
+                                   int64_t delta)
 {
     CPURISCVState *env = &cpu->env;
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
-    uint64_t max_val = UINT64_MAX;
     bool virt_on = env->virt_enabled;
+    uint64_t old;
 
     if (!riscv_pmu_has_andes_pmnds(cpu)) {
         /* Privilege mode filtering */
@@ -221,10 +227,11 @@ static int riscv_pmu_incr_ctr_rv64(RISCVCPU *cpu, uint32_t ctr_idx)
         }
     }
 
-    /* Handle the overflow scenario */
-    if (counter->mhpmcounter_val == max_val) {
-        counter->mhpmcounter_val = 0;
+    old = counter->mhpmcounter_val;
+    counter->mhpmcounter_val = old + delta;
 
+    /* Handle the overflow scenario, "pmu-exact" also takes counts back */
+    if (delta > 0 && counter->mhpmcounter_val < old) {
         if (riscv_pmu_has_andes_pmnds(cpu)) {
             riscv_pmu_handle_andes_pmovi_interrupt(env, ctr_idx);
         } else {
@@ -234,13 +241,17 @@ static int riscv_pmu_incr_ctr_rv64(RISCVCPU *cpu, uint32_t ctr_idx)
                 riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
             }
         }
-    } else {
-        counter->mhpmcounter_val++;
     }
     return 0;
 }
 
 int riscv_pmu_incr_ctr(RISCVCPU *cpu, enum riscv_pmu_event_idx event_idx)
+{
+    return riscv_pmu_add_ctr(cpu, event_idx, 1);
+}
+
+int riscv_pmu_add_ctr(RISCVCPU *cpu, enum riscv_pmu_event_idx event_idx,
+                      int64_t delta)
 {
     uint32_t ctr_idx;
     int ret;
@@ -263,14 +274,93 @@ int riscv_pmu_incr_ctr(RISCVCPU *cpu, enum riscv_pmu_event_idx event_idx)
     }
 
     if (riscv_cpu_mxl(env) == MXL_RV32) {
-        ret = riscv_pmu_incr_ctr_rv32(cpu, ctr_idx);
+        ret = riscv_pmu_incr_ctr_rv32(cpu, ctr_idx, delta);
     } else {
-        ret = riscv_pmu_incr_ctr_rv64(cpu, ctr_idx);
+        ret = riscv_pmu_incr_ctr_rv64(cpu, ctr_idx, delta);
     }
 
     return ret;
 }
 
+/*
+ * "pmu-exact" mode: every TB adds the counts of all its insns when it is
+ * entered, and a TB that is left by a trap gives back the counts of the
+ * insns from the trapping one on.  mcycle and minstret are derived from
+ * pmu_exact_insns, and the events are added to the programmable counters
+ * like any other, so that the overflow interrupt is raised by the TB that
+ * wraps the counter rather than by a timer.  There is one cycle per insn,
+ * as with icount.
+ *
+ * The counter values are exact whenever the guest can read them, as CSR
+ * accesses end the TB and traps give their counts back first.  The
+ * overflow interrupt is not: it is raised when the TB's counts are added
+ * on entry, so LCOFIP/PMOVI may be set up to one TB early, including for
+ * insns that a trap later in the TB gives back, and is taken at the start
+ * of the next TB.
+ */
+static void riscv_pmu_exact_add(RISCVCPU *cpu, int64_t insns,
+                                int64_t loads, int64_t stores,
+                                int64_t branches)
+{
+    bool pmnds = riscv_pmu_has_andes_pmnds(cpu);
+
+    cpu->env.pmu_exact_insns += insns;
+    if (!cpu->cfg.pmu_mask) {
+        return;
+    }
+
+    if (insns) {
+        riscv_pmu_add_ctr(cpu, pmnds ? RISCV_PMU_EVENT_ANDES_CPU_CYCLES :
+                                       RISCV_PMU_EVENT_HW_CPU_CYCLES, insns);
+        riscv_pmu_add_ctr(cpu, pmnds ? RISCV_PMU_EVENT_ANDES_INSTRUCTIONS :
+                                       RISCV_PMU_EVENT_HW_INSTRUCTIONS, insns);
+    }
+    if (branches) {
+        riscv_pmu_add_ctr(cpu, pmnds ? RISCV_PMU_EVENT_ANDES_COND_BRANCH :
+                                       RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS,
+                          branches);
+    }
+    /* There are no SBI events for loads and stores */
+    if (pmnds && loads) {
+        riscv_pmu_add_ctr(cpu, RISCV_PMU_EVENT_ANDES_INT_LOAD, loads);
+    }
+    if (pmnds && stores) {
+        riscv_pmu_add_ctr(cpu, RISCV_PMU_EVENT_ANDES_INT_STORE, stores);
+    }
+}
+
+void helper_pmu_exact_count(CPURISCVState *env, uint32_t counts)
+{
+    env->pmu_exact_tb = counts;
+    riscv_pmu_exact_add(env_archcpu(env),
+                        FIELD_EX32(counts, PMU_EXACT, INSNS),
+                        FIELD_EX32(counts, PMU_EXACT, LOADS),
+                        FIELD_EX32(counts, PMU_EXACT, STORES),
+                        FIELD_EX32(counts, PMU_EXACT, BRANCHES));
+}
+
+/* @counts are those of the insns that retired before the trapping one */
+void riscv_pmu_exact_unwind(CPURISCVState *env, uint32_t counts)
+{
+    uint32_t tb = env->pmu_exact_tb;
+
+    env->pmu_exact_tb = counts;
+    riscv_pmu_exact_add(env_archcpu(env),
+                        (int64_t)FIELD_EX32(counts, PMU_EXACT, INSNS) -
+                        FIELD_EX32(tb, PMU_EXACT, INSNS),
+                        (int64_t)FIELD_EX32(counts, PMU_EXACT, LOADS) -
+                        FIELD_EX32(tb, PMU_EXACT, LOADS),
+                        (int64_t)FIELD_EX32(counts, PMU_EXACT, STORES) -
+                        FIELD_EX32(tb, PMU_EXACT, STORES),
+                        (int64_t)FIELD_EX32(counts, PMU_EXACT, BRANCHES) -
+                        FIELD_EX32(tb, PMU_EXACT, BRANCHES));
+}
+
+void helper_pmu_exact_unwind(CPURISCVState *env, uint32_t counts)
+{
+    riscv_pmu_exact_unwind(env, counts);
+}
+
 bool riscv_pmu_ctr_monitor_instructions(CPURISCVState *env,
                                         uint32_t target_ctr)
 {
@@ -283,8 +373,9 @@ bool riscv_pmu_ctr_monitor_instructions(CPURISCVState *env,
         return true;
     }
 
+    /* With "pmu-exact" the programmable counters are counted like events */
     cpu = env_archcpu(env);
-    if (!cpu->pmu_event_ctr_map) {
+    if (!cpu->pmu_event_ctr_map || cpu->cfg.pmu_exact) {
         return false;
     }
 
@@ -313,8 +404,9 @@ bool riscv_pmu_ctr_monitor_cycles(CPURISCVState *env, uint32_t target_ctr)
         return true;
     }
 
+    /* With "pmu-exact" the programmable counters are counted like events */
     cpu = env_archcpu(env);
-    if (!cpu->pmu_event_ctr_map) {
+    if (!cpu->pmu_event_ctr_map || cpu->cfg.pmu_exact) {
         return false;
     }
 
@@ -384,8 +476,24 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
         switch (event_idx) {
         case RISCV_PMU_EVENT_ANDES_CPU_CYCLES:
         case RISCV_PMU_EVENT_ANDES_INSTRUCTIONS:
+        case RISCV_PMU_EVENT_ANDES_INT_LOAD:
+        case RISCV_PMU_EVENT_ANDES_INT_STORE:
+        case RISCV_PMU_EVENT_ANDES_COND_BRANCH:
         case RISCV_PMU_EVENT_ANDES_DTLB_MISS:
         case RISCV_PMU_EVENT_ANDES_ITLB_MISS:
+        case RISCV_PMU_EVENT_ANDES_ICACHE_ACCESS:
+        case RISCV_PMU_EVENT_ANDES_ICACHE_MISS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_ACCESS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_MISS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_ACCESS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_LOAD_MISS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_STORE_ACCESS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_STORE_MISS:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_WB:
+        case RISCV_PMU_EVENT_ANDES_ICACHE_FILL_CYCLES:
+        case RISCV_PMU_EVENT_ANDES_DCACHE_FILL_CYCLES:
+        case RISCV_PMU_EVENT_ANDES_UNCACHED_FETCH:
+        case RISCV_PMU_EVENT_ANDES_UNCACHED_LOAD:
             break;
         default:
             /* We don't support any raw events right now */
@@ -395,6 +503,7 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
         switch (event_idx) {
         case RISCV_PMU_EVENT_HW_CPU_CYCLES:
         case RISCV_PMU_EVENT_HW_INSTRUCTIONS:
+        case RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS:
         case RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS:
         case RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS:
         case RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS:
@@ -19,6 +19,16 @@
 #include "cpu.h"
 #include "qapi/error.h"
 
+/*
+ * Counts packed by the translator for the "pmu-exact" mode, both for a
+ * whole TB and, in the insn_start data, for the insns that precede each
+ * insn.  A conditional branch ends the TB, so there is at most one.
+ */
+FIELD(PMU_EXACT, INSNS, 0, 10)
+FIELD(PMU_EXACT, LOADS, 10, 10)
+FIELD(PMU_EXACT, STORES, 20, 10)
+FIELD(PMU_EXACT, BRANCHES, 30, 2)
+
 bool riscv_pmu_ctr_monitor_instructions(CPURISCVState *env,
                                         uint32_t target_ctr);
 bool riscv_pmu_ctr_monitor_cycles(CPURISCVState *env,
@@ -28,6 +38,9 @@ void riscv_pmu_init(RISCVCPU *cpu, Error **errp);
 int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
                                uint32_t ctr_idx);
 int riscv_pmu_incr_ctr(RISCVCPU *cpu, enum riscv_pmu_event_idx event_idx);
+int riscv_pmu_add_ctr(RISCVCPU *cpu, enum riscv_pmu_event_idx event_idx,
+                      int64_t delta);
+void riscv_pmu_exact_unwind(CPURISCVState *env, uint32_t counts);
 void riscv_pmu_generate_fdt_node(void *fdt, uint32_t cmask, char *pmu_name);
 int riscv_pmu_setup_timer(CPURISCVState *env, uint64_t value,
                           uint32_t ctr_idx);
@@ -80,6 +80,11 @@ static void riscv_restore_state_to_opc(CPUState *cs,
         env->pc = pc;
     }
     env->bins = data[1];
+#ifndef CONFIG_USER_ONLY
+    if (cpu->cfg.pmu_exact) {
+        riscv_pmu_exact_unwind(env, data[2]);
+    }
+#endif
 }
 
 static const struct TCGCPUOps riscv_tcg_ops = {
@@ -32,6 +32,8 @@
 
 #include "instmap.h"
 #include "internals.h"
+#include "andes_cache.h"
+#include "pmu.h"
 
 #define HELPER_H "helper.h"
 #include "exec/helper-info.c.inc"
@@ -57,6 +59,16 @@ typedef enum {
     EXT_ZERO,
 } DisasExtend;
 
+#define SUPERBLOCK_MAX_EXITS    4
+
+/* A taken branch out of a superblock, emitted after the end of the TB */
+typedef struct SuperblockExit {
+    TCGLabel *label;
+    target_ulong pc;
+    target_ulong pc_save;
+    target_long diff;
+} SuperblockExit;
+
 typedef struct DisasContext {
     DisasContextBase base;
     target_ulong cur_insn_len;
@@ -104,6 +116,8 @@ typedef struct DisasContext {
     bool cfg_vta_all_1s;
     bool vstart_eq_zero;
     bool vl_eq_vlmax;
+    /* vl when it is known at translation time, 0 otherwise */
+    uint32_t vl_static;
     CPUState *cs;
     TCGv zero;
     /* PointerMasking extension */
@@ -115,6 +129,27 @@ typedef struct DisasContext {
     bool frm_valid;
     /* TCG of the current insn_start */
     TCGOp *insn_start;
+    /* Andes cache model: fetch line size and the last line fetched */
+    bool andes_cache;
+    int icache_line_bits;
+    target_ulong icache_line;
+    /*
+     * "pmu-exact": the op patched with the counts of the TB, the counts so
+     * far and those of the insns before the current one.
+     */
+    bool pmu_exact;
+    TCGOp *pmu_exact_op;
+    uint32_t pmu_exact_counts;
+    uint32_t pmu_exact_before;
+    /*
+     * "x-superblocks": whether this TB is profiled or is a superblock, the
+     * side exits of the superblock so far, and the goto_tb slots in use.
+     */
+    bool superblocks;
+    bool superblock;
+    int superblock_exits;
+    SuperblockExit superblock_exit[SUPERBLOCK_MAX_EXITS];
+    uint8_t goto_tb_used;
 } DisasContext;
 
 static inline bool has_ext(DisasContext *ctx, uint32_t ext)
@@ -235,9 +270,127 @@ static void gen_update_pc(DisasContext *ctx, target_long diff)
     ctx->pc_save = ctx->base.pc_next + diff;
 }
 
+/*
+ * Report instruction fetches to the Andes cache model, once per I-cache
+ * line that the TB enters.
+ */
+static void gen_andes_cache_fetch(DisasContext *ctx)
+{
+#ifndef CONFIG_USER_ONLY
+    target_ulong line = ctx->base.pc_next >> ctx->icache_line_bits;
+    TCGv pc;
+
+    if (!ctx->andes_cache || line == ctx->icache_line) {
+        return;
+    }
+    ctx->icache_line = line;
+    pc = tcg_temp_new();
+    gen_pc_plus_diff(pc, ctx, 0);
+    gen_helper_andes_cache_fetch(tcg_env, pc);
+#endif
+}
+
+/* Report a data access of @memop at @addr to the Andes cache model */
+static void gen_andes_cache_data(DisasContext *ctx, TCGv addr, MemOp memop,
+                                 bool store)
+{
+#ifndef CONFIG_USER_ONLY
+    if (ctx->andes_cache) {
+        uint32_t info = memop_size(memop) | (store ? ANDES_CACHE_STORE : 0);
+
+        gen_helper_andes_cache_data(tcg_env, addr, tcg_constant_i32(info));
+    }
+#endif
+}
+
+/* Count an event of the current insn, e.g. R_PMU_EXACT_LOADS_SHIFT */
+static void pmu_exact_event(DisasContext *ctx, int shift)
+{
+    if (ctx->pmu_exact) {
+        ctx->pmu_exact_counts += 1 << shift;
+    }
+}
+
+/*
+ * "x-superblocks": a TB that ends in a forward conditional branch counts
+ * how often it falls through.  Once that gets hot, the TB is dropped and
+ * translated again as a superblock, which carries on through the
+ * fall-through of its forward branches and leaves through a side exit
+ * where one is taken.
+ *
+ * The side exits are emitted out of line after the end of the TB, so
+ * that the fall-through is straight-line code: a conditional branch only
+ * syncs the guest registers to env, and they stay in host registers on
+ * the fall-through, while a label (or a TB boundary) discards them.
+ */
+#define SUPERBLOCK_HOT          1024
+
+static unsigned superblock_heat_index(DisasContext *ctx)
+{
+    target_ulong pc = ctx->base.pc_first;
+
+    /* A pc-relative TB runs at every virtual address of its page */
+    if (tb_cflags(ctx->base.tb) & CF_PCREL) {
+        pc &= ~TARGET_PAGE_MASK;
+    }
+    return (pc >> 1) % RISCV_SUPERBLOCK_HEAT_SIZE;
+}
+
+/* Count the fall-through of a branch to @diff that ends the TB */
+static void gen_superblock_heat(DisasContext *ctx, target_long diff)
+{
+    intptr_t ofs = offsetof(CPURISCVState,
+                            superblock_heat[superblock_heat_index(ctx)]);
+    target_ulong orig_pc_save = ctx->pc_save;
+    TCGLabel *cold;
+    TCGv_i32 heat;
+
+    if (!ctx->superblocks || ctx->superblock || diff <= 0) {
+        return;
+    }
+
+    cold = gen_new_label();
+    heat = tcg_temp_new_i32();
+    tcg_gen_ld16u_i32(heat, tcg_env, ofs);
+    tcg_gen_addi_i32(heat, heat, 1);
+    tcg_gen_st16_i32(heat, tcg_env, ofs);
+    tcg_gen_brcondi_i32(TCG_COND_NE, heat, SUPERBLOCK_HOT, cold);
+    gen_update_pc(ctx, ctx->cur_insn_len);
+    gen_helper_superblock_promote(tcg_env, tcg_constant_ptr(ctx->base.tb));
+    gen_set_label(cold);
+    ctx->pc_save = orig_pc_save;
+}
+
+/*
+ * If a superblock carries on past a branch to @diff, return the label of
+ * its side exit, else NULL.
+ */
+static TCGLabel *superblock_side_exit(DisasContext *ctx, target_long diff)
+{
+    SuperblockExit *e;
+
+    if (!ctx->superblock || diff <= 0 ||
+        ctx->superblock_exits == SUPERBLOCK_MAX_EXITS) {
+        return NULL;
+    }
+    e = &ctx->superblock_exit[ctx->superblock_exits++];
+    e->label = gen_new_label();
+    e->pc = ctx->base.pc_next;
+    e->pc_save = ctx->pc_save;
+    e->diff = diff;
+    return e->label;
+}
+
 static void generate_exception(DisasContext *ctx, int excp)
 {
     gen_update_pc(ctx, 0);
+#ifndef CONFIG_USER_ONLY
+    if (ctx->pmu_exact) {
+        /* The insn that raises the exception does not retire */
+        gen_helper_pmu_exact_unwind(tcg_env,
+                                    tcg_constant_i32(ctx->pmu_exact_before));
+    }
+#endif
     gen_helper_raise_exception(tcg_env, tcg_constant_i32(excp));
     ctx->base.is_jmp = DISAS_NORETURN;
 }
@@ -283,11 +436,18 @@ static void gen_goto_tb(DisasContext *ctx, int n, target_long diff)
 {
     target_ulong dest = ctx->base.pc_next + diff;
 
+    /* The side exits of a superblock may have used up the slots */
+    if (ctx->goto_tb_used & (1 << n)) {
+        n ^= 1;
+    }
+
      /*
       * Under itrigger, instruction executes one by one like singlestep,
       * direct block chain benefits will be small.
       */
-    if (translator_use_goto_tb(&ctx->base, dest) && !ctx->itrigger) {
+    if (translator_use_goto_tb(&ctx->base, dest) && !ctx->itrigger &&
+        !(ctx->goto_tb_used & (1 << n))) {
+        ctx->goto_tb_used |= 1 << n;
         /*
          * For pcrel, the pc must always be up-to-date on entry to
          * the linked TB, so that it can use simple additions for all
@@ -1234,6 +1394,7 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->cfg_vta_all_1s = cpu->cfg.rvv_ta_all_1s;
     ctx->vstart_eq_zero = FIELD_EX32(tb_flags, TB_FLAGS, VSTART_EQ_ZERO);
     ctx->vl_eq_vlmax = FIELD_EX32(tb_flags, TB_FLAGS, VL_EQ_VLMAX);
+    ctx->vl_static = ctx->base.tb->cs_base;
     ctx->misa_mxl_max = env->misa_mxl_max;
     ctx->xl = FIELD_EX32(tb_flags, TB_FLAGS, XL);
     ctx->address_xl = FIELD_EX32(tb_flags, TB_FLAGS, AXL);
@@ -1243,10 +1404,46 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->itrigger = FIELD_EX32(tb_flags, TB_FLAGS, ITRIGGER);
     ctx->zero = tcg_constant_tl(0);
     ctx->virt_inst_excp = false;
+#ifndef CONFIG_USER_ONLY
+    ctx->andes_cache = env->andes_cache != NULL;
+    if (ctx->andes_cache) {
+        ctx->icache_line_bits = andes_cache_fetch_line_bits(env);
+    }
+    ctx->pmu_exact = cpu->cfg.pmu_exact;
+#else
+    ctx->pmu_exact = false;
+#endif
+    ctx->icache_line = -1;
+    ctx->pmu_exact_counts = 0;
+    ctx->pmu_exact_before = 0;
+
+    /*
+     * The insn counts of pmu-exact and icount are charged for the whole
+     * TB on entry, which side exits would get wrong.
+     */
+    ctx->superblocks = cpu->cfg.superblocks && !ctx->itrigger &&
+                       !ctx->pmu_exact &&
+                       !(tb_cflags(ctx->base.tb) & CF_USE_ICOUNT);
+    ctx->superblock = ctx->superblocks &&
+        env->superblock_heat[superblock_heat_index(ctx)] >= SUPERBLOCK_HOT;
+    ctx->superblock_exits = 0;
+    ctx->goto_tb_used = 0;
 }
 
 static void riscv_tr_tb_start(DisasContextBase *db, CPUState *cpu)
 {
+#ifndef CONFIG_USER_ONLY
+    DisasContext *ctx = container_of(db, DisasContext, base);
+
+    if (ctx->pmu_exact) {
+        TCGv_i32 counts = tcg_temp_new_i32();
+
+        /* The counts are only known once the TB is translated */
+        tcg_gen_mov_i32(counts, tcg_constant_i32(0));
+        ctx->pmu_exact_op = tcg_last_op();
+        gen_helper_pmu_exact_count(tcg_env, counts);
+    }
+#endif
 }
 
 static void riscv_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
@@ -1258,7 +1455,10 @@ static void riscv_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
         pc_next &= ~TARGET_PAGE_MASK;
     }
 
-    tcg_gen_insn_start(pc_next, 0);
+    ctx->pmu_exact_before = ctx->pmu_exact_counts;
+    pmu_exact_event(ctx, R_PMU_EXACT_INSNS_SHIFT);
+
+    tcg_gen_insn_start(pc_next, 0, ctx->pmu_exact_before);
     ctx->insn_start = tcg_last_op();
 }
 
@@ -1276,6 +1476,7 @@ static void riscv_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 #endif
 
     ctx->ol = ctx->xl;
+    gen_andes_cache_fetch(ctx);
     decode_opc(env, ctx, opcode16);
     ctx->base.pc_next += ctx->cur_insn_len;
 
@@ -1301,6 +1502,8 @@ static void riscv_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 static void riscv_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *ctx = container_of(dcbase, DisasContext, base);
+    target_ulong pc_next = ctx->base.pc_next;
+    int i;
 
     switch (ctx->base.is_jmp) {
     case DISAS_TOO_MANY:
@@ -1311,6 +1514,26 @@ static void riscv_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     default:
         g_assert_not_reached();
     }
+
+    /*
+     * The side exits of a superblock, as if at their branch.  The size of
+     * the TB is taken from pc_next afterwards.
+     */
+    for (i = 0; i < ctx->superblock_exits; i++) {
+        SuperblockExit *e = &ctx->superblock_exit[i];
+
+        gen_set_label(e->label);
+        ctx->base.pc_next = e->pc;
+        ctx->pc_save = e->pc_save;
+        gen_goto_tb(ctx, 0, e->diff);
+    }
+    ctx->base.pc_next = pc_next;
+
+    if (ctx->pmu_exact) {
+        TCGv_i32 counts = tcg_constant_i32(ctx->pmu_exact_counts);
+
+        tcg_set_insn_param(ctx->pmu_exact_op, 1, tcgv_i32_arg(counts));
+    }
 }
 
 static void riscv_tr_disas_log(const DisasContextBase *dcbase,
@@ -29,6 +29,7 @@
 #include "internals.h"
 #include "vector_internals.h"
 #include "andes_fpu_helper.h"
+#include "andes_cache.h"
 #include <math.h>
 
 target_ulong HELPER(vsetvl)(CPURISCVState *env, target_ulong s1,
@@ -164,6 +165,140 @@ GEN_VEXT_ST_ELEM(ste_h, int16_t, H2, stw)
 GEN_VEXT_ST_ELEM(ste_w, int32_t, H4, stl)
 GEN_VEXT_ST_ELEM(ste_d, int64_t, H8, stq)
 
+/* elements operations on a host pointer from vext_probe_host() */
+typedef void vext_ldst_elem_fn_host(void *vd, uint32_t idx, void *host);
+
+#define GEN_VEXT_LD_ELEM_HOST(NAME, ETYPE, H, LDSUF)       \
+static void NAME(void *vd, uint32_t idx, void *host)       \
+{                                                          \
+    ETYPE *cur = ((ETYPE *)vd + H(idx));                   \
+    *cur = LDSUF##_p(host);                                \
+}
+
+GEN_VEXT_LD_ELEM_HOST(lde_b_host, int8_t,  H1, ldsb)
+GEN_VEXT_LD_ELEM_HOST(lde_h_host, int16_t, H2, ldsw_le)
+GEN_VEXT_LD_ELEM_HOST(lde_w_host, int32_t, H4, ldl_le)
+GEN_VEXT_LD_ELEM_HOST(lde_d_host, int64_t, H8, ldq_le)
+
+#define GEN_VEXT_ST_ELEM_HOST(NAME, ETYPE, H, STSUF)       \
+static void NAME(void *vd, uint32_t idx, void *host)       \
+{                                                          \
+    ETYPE data = *((ETYPE *)vd + H(idx));                  \
+    STSUF##_p(host, data);                                 \
+}
+
+GEN_VEXT_ST_ELEM_HOST(ste_b_host, int8_t,  H1, stb)
+GEN_VEXT_ST_ELEM_HOST(ste_h_host, int16_t, H2, stw_le)
+GEN_VEXT_ST_ELEM_HOST(ste_w_host, int32_t, H4, stl_le)
+GEN_VEXT_ST_ELEM_HOST(ste_d_host, int64_t, H8, stq_le)
+
+/*
+ * Return a host pointer for [addr, addr + len), which must not cross a
+ * page, or NULL if the range has to go through the softmmu an element at
+ * a time: MMIO, watchpoints, pages mapped with less than TARGET_PAGE_SIZE
+ * (e.g. by PMP) and accesses that would fault.  The probe never faults, so
+ * that the element path raises any exception with the right vstart.
+ */
+static void *vext_probe_host(CPURISCVState *env, target_ulong addr,
+                             target_ulong len, MMUAccessType access_type,
+                             uintptr_t ra)
+{
+    void *host;
+    int flags;
+
+    /* Pointer masking must not move the range within the page */
+    if (env->cur_pmmask & ~TARGET_PAGE_MASK) {
+        return NULL;
+    }
+    flags = probe_access_flags(env, adjust_addr(env, addr), len, access_type,
+                               cpu_mmu_index(env, false), true, &host, ra);
+    return flags == 0 ? host : NULL;
+}
+
+/*
+ * Whether a run of elements may be moved with one memcpy.  Only byte
+ * elements keep their single-copy atomicity when other vCPUs run in
+ * parallel, and the register file is only laid out like memory on little
+ * endian hosts.
+ */
+static inline bool vext_ldst_bulk_ok(CPURISCVState *env, uint32_t esz)
+{
+#if HOST_BIG_ENDIAN
+    return false;
+#else
+    return esz == 1 || !(env_cpu(env)->tcg_cflags & CF_PARALLEL);
+#endif
+}
+
+/*
+ * Access the segments [vstart, evl) of a vector whose segments are laid
+ * out contiguously in memory, a page at a time.  A run of segments within
+ * a page of RAM is accessed through a host pointer, with one memcpy if it
+ * is unmasked and has a single field.  Everything else, including segments
+ * straddling two pages, goes through ldst_elem.
+ */
+static void
+vext_ldst_contig(void *vd, void *v0, target_ulong base, CPURISCVState *env,
+                 uint32_t desc, uint32_t vm, vext_ldst_elem_fn *ldst_elem,
+                 vext_ldst_elem_fn_host *ldst_host, uint32_t log2_esz,
+                 uint32_t evl, uintptr_t ra, MMUAccessType access_type)
+{
+    uint32_t i, j, k, n;
+    uint32_t nf = vext_nf(desc);
+    uint32_t max_elems = vext_max_elems(desc, log2_esz);
+    uint32_t esz = 1 << log2_esz;
+    uint32_t vma = vext_vma(desc);
+    uint32_t segsz = nf << log2_esz;
+    target_ulong addr, pagelen;
+    void *host;
+
+    for (i = env->vstart; i < evl; i += n) {
+        addr = base + i * segsz;
+        pagelen = -(addr | TARGET_PAGE_MASK);
+        n = MIN(evl - i, MAX(pagelen / segsz, 1u));
+        host = NULL;
+        if (n * segsz <= pagelen) {
+            host = vext_probe_host(env, addr, n * segsz, access_type, ra);
+        }
+
+        if (host && vm && nf == 1 && vext_ldst_bulk_ok(env, esz)) {
+            if (access_type == MMU_DATA_LOAD) {
+                memcpy(vd + (i << log2_esz), host, n << log2_esz);
+            } else {
+                memcpy(host, vd + (i << log2_esz), n << log2_esz);
+            }
+            andes_cache_data(env, adjust_addr(env, addr), n * segsz,
+                             access_type == MMU_DATA_STORE);
+            env->vstart += n;
+            continue;
+        }
+
+        for (j = i; j < i + n; j++, env->vstart++) {
+            for (k = 0; k < nf; k++) {
+                if (!vm && !vext_elem_mask(v0, j)) {
+                    /* set masked-off elements to 1s */
+                    vext_set_elems_1s(vd, vma, (j + k * max_elems) * esz,
+                                      (j + k * max_elems + 1) * esz);
+                    continue;
+                }
+                addr = base + j * segsz + (k << log2_esz);
+                if (host) {
+                    ldst_host(vd, j + k * max_elems,
+                              host + (j - i) * segsz + (k << log2_esz));
+                } else {
+                    ldst_elem(env, adjust_addr(env, addr), j + k * max_elems,
+                              vd, ra);
+                }
+                andes_cache_data(env, adjust_addr(env, addr), esz,
+                                 access_type == MMU_DATA_STORE);
+            }
+        }
+    }
+    env->vstart = 0;
+
+    vext_set_tail_elems_1s(evl, vd, desc, nf, esz, max_elems);
+}
+
 static void vext_set_tail_elems_1s(target_ulong vl, void *vd,
                                    uint32_t desc, uint32_t nf,
                                    uint32_t esz, uint32_t max_elems)
@@ -189,7 +324,9 @@ vext_ldst_stride(void *vd, void *v0, target_ulong base,
                  target_ulong stride, CPURISCVState *env,
                  uint32_t desc, uint32_t vm,
                  vext_ldst_elem_fn *ldst_elem,
-                 uint32_t log2_esz, uintptr_t ra)
+                 vext_ldst_elem_fn_host *ldst_host,
+                 uint32_t log2_esz, uintptr_t ra,
+                 MMUAccessType access_type)
 {
     uint32_t i, k;
     uint32_t nf = vext_nf(desc);
@@ -197,6 +334,13 @@ vext_ldst_stride(void *vd, void *v0, target_ulong base,
     uint32_t esz = 1 << log2_esz;
     uint32_t vma = vext_vma(desc);
 
+    /* masked unit-stride, or a stride that happens to be contiguous */
+    if (stride == (nf << log2_esz)) {
+        vext_ldst_contig(vd, v0, base, env, desc, vm, ldst_elem, ldst_host,
+                         log2_esz, env->vl, ra, access_type);
+        return;
+    }
+
     for (i = env->vstart; i < env->vl; i++, env->vstart++) {
         k = 0;
         while (k < nf) {
@@ -209,6 +353,8 @@ vext_ldst_stride(void *vd, void *v0, target_ulong base,
             }
             target_ulong addr = base + stride * i + (k << log2_esz);
             ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            andes_cache_data(env, adjust_addr(env, addr), esz,
+                             access_type == MMU_DATA_STORE);
             k++;
         }
     }
@@ -224,7 +370,8 @@ void HELPER(NAME)(void *vd, void * v0, target_ulong base,               \
 {                                                                       \
     uint32_t vm = vext_vm(desc);                                        \
     vext_ldst_stride(vd, v0, base, stride, env, desc, vm, LOAD_FN,      \
-                     ctzl(sizeof(ETYPE)), GETPC());                     \
+                     LOAD_FN##_host, ctzl(sizeof(ETYPE)), GETPC(),      \
+                     MMU_DATA_LOAD);                                    \
 }
 
 GEN_VEXT_LD_STRIDE(vlse8_v,  int8_t,  lde_b)
@@ -239,7 +386,8 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong base,                \
 {                                                                       \
     uint32_t vm = vext_vm(desc);                                        \
     vext_ldst_stride(vd, v0, base, stride, env, desc, vm, STORE_FN,     \
-                     ctzl(sizeof(ETYPE)), GETPC());                     \
+                     STORE_FN##_host, ctzl(sizeof(ETYPE)), GETPC(),     \
+                     MMU_DATA_STORE);                                   \
 }
 
 GEN_VEXT_ST_STRIDE(vsse8_v,  int8_t,  ste_b)
@@ -254,26 +402,12 @@ GEN_VEXT_ST_STRIDE(vsse64_v, int64_t, ste_d)
 /* unmasked unit-stride load and store operation */
 static void
 vext_ldst_us(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
-             vext_ldst_elem_fn *ldst_elem, uint32_t log2_esz, uint32_t evl,
-             uintptr_t ra)
+             vext_ldst_elem_fn *ldst_elem, vext_ldst_elem_fn_host *ldst_host,
+             uint32_t log2_esz, uint32_t evl, uintptr_t ra,
+             MMUAccessType access_type)
 {
-    uint32_t i, k;
-    uint32_t nf = vext_nf(desc);
-    uint32_t max_elems = vext_max_elems(desc, log2_esz);
-    uint32_t esz = 1 << log2_esz;
-
-    /* load bytes from guest memory */
-    for (i = env->vstart; i < evl; i++, env->vstart++) {
-        k = 0;
-        while (k < nf) {
-            target_ulong addr = base + ((i * nf + k) << log2_esz);
-            ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
-            k++;
-        }
-    }
-    env->vstart = 0;
-
-    vext_set_tail_elems_1s(evl, vd, desc, nf, esz, max_elems);
+    vext_ldst_contig(vd, NULL, base, env, desc, 1, ldst_elem, ldst_host,
+                     log2_esz, evl, ra, access_type);
 }
 
 /*
@@ -287,14 +421,15 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,         \
 {                                                                       \
     uint32_t stride = vext_nf(desc) << ctzl(sizeof(ETYPE));             \
     vext_ldst_stride(vd, v0, base, stride, env, desc, false, LOAD_FN,   \
-                     ctzl(sizeof(ETYPE)), GETPC());                     \
+                     LOAD_FN##_host, ctzl(sizeof(ETYPE)), GETPC(),      \
+                     MMU_DATA_LOAD);                                    \
 }                                                                       \
                                                                         \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                \
                   CPURISCVState *env, uint32_t desc)                    \
 {                                                                       \
-    vext_ldst_us(vd, base, env, desc, LOAD_FN,                          \
-                 ctzl(sizeof(ETYPE)), env->vl, GETPC());                \
+    vext_ldst_us(vd, base, env, desc, LOAD_FN, LOAD_FN##_host,          \
+                 ctzl(sizeof(ETYPE)), env->vl, GETPC(), MMU_DATA_LOAD); \
 }
 
 GEN_VEXT_LD_US(vle8_v,  int8_t,  lde_b)
@@ -308,14 +443,15 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,          \
 {                                                                        \
     uint32_t stride = vext_nf(desc) << ctzl(sizeof(ETYPE));              \
     vext_ldst_stride(vd, v0, base, stride, env, desc, false, STORE_FN,   \
-                     ctzl(sizeof(ETYPE)), GETPC());                      \
+                     STORE_FN##_host, ctzl(sizeof(ETYPE)), GETPC(),      \
+                     MMU_DATA_STORE);                                    \
 }                                                                        \
                                                                          \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                 \
                   CPURISCVState *env, uint32_t desc)                     \
 {                                                                        \
-    vext_ldst_us(vd, base, env, desc, STORE_FN,                          \
-                 ctzl(sizeof(ETYPE)), env->vl, GETPC());                 \
+    vext_ldst_us(vd, base, env, desc, STORE_FN, STORE_FN##_host,         \
+                 ctzl(sizeof(ETYPE)), env->vl, GETPC(), MMU_DATA_STORE); \
 }
 
 GEN_VEXT_ST_US(vse8_v,  int8_t,  ste_b)
@@ -331,8 +467,8 @@ void HELPER(vlm_v)(void *vd, void *v0, target_ulong base,
 {
     /* evl = ceil(vl/8) */
     uint8_t evl = (env->vl + 7) >> 3;
-    vext_ldst_us(vd, base, env, desc, lde_b,
-                 0, evl, GETPC());
+    vext_ldst_us(vd, base, env, desc, lde_b, lde_b_host,
+                 0, evl, GETPC(), MMU_DATA_LOAD);
 }
 
 void HELPER(vsm_v)(void *vd, void *v0, target_ulong base,
@@ -340,8 +476,8 @@ void HELPER(vsm_v)(void *vd, void *v0, target_ulong base,
 {
     /* evl = ceil(vl/8) */
     uint8_t evl = (env->vl + 7) >> 3;
-    vext_ldst_us(vd, base, env, desc, ste_b,
-                 0, evl, GETPC());
+    vext_ldst_us(vd, base, env, desc, ste_b, ste_b_host,
+                 0, evl, GETPC(), MMU_DATA_STORE);
 }
 
 /*
@@ -367,7 +503,7 @@ vext_ldst_index(void *vd, void *v0, target_ulong base,
                 void *vs2, CPURISCVState *env, uint32_t desc,
                 vext_get_index_addr get_index_addr,
                 vext_ldst_elem_fn *ldst_elem,
-                uint32_t log2_esz, uintptr_t ra)
+                uint32_t log2_esz, uintptr_t ra, MMUAccessType access_type)
 {
     uint32_t i, k;
     uint32_t nf = vext_nf(desc);
@@ -389,6 +525,8 @@ vext_ldst_index(void *vd, void *v0, target_ulong base,
             }
             abi_ptr addr = get_index_addr(base, i, vs2) + (k << log2_esz);
             ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            andes_cache_data(env, adjust_addr(env, addr), esz,
+                             access_type == MMU_DATA_STORE);
             k++;
         }
     }
@@ -402,7 +540,8 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong base,                   \
                   void *vs2, CPURISCVState *env, uint32_t desc)            \
 {                                                                          \
     vext_ldst_index(vd, v0, base, vs2, env, desc, INDEX_FN,                \
-                    LOAD_FN, ctzl(sizeof(ETYPE)), GETPC());                \
+                    LOAD_FN, ctzl(sizeof(ETYPE)), GETPC(),                 \
+                    MMU_DATA_LOAD);                                        \
 }
 
 GEN_VEXT_LD_INDEX(vlxei8_8_v,   int8_t,  idx_b, lde_b)
@@ -428,7 +567,7 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong base,         \
 {                                                                \
     vext_ldst_index(vd, v0, base, vs2, env, desc, INDEX_FN,      \
                     STORE_FN, ctzl(sizeof(ETYPE)),               \
-                    GETPC());                                    \
+                    GETPC(), MMU_DATA_STORE);                    \
 }
 
 GEN_VEXT_ST_INDEX(vsxei8_8_v,   int8_t,  idx_b, ste_b)
@@ -519,6 +658,7 @@ ProbeSuccess:
             }
             addr = base + ((i * nf + k) << log2_esz);
             ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            andes_cache_data(env, adjust_addr(env, addr), esz, false);
             k++;
         }
     }
@@ -555,7 +695,8 @@ GEN_VEXT_LDFF(vle64ff_v, int64_t, lde_d)
  */
 static void
 vext_ldst_whole(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
-                vext_ldst_elem_fn *ldst_elem, uint32_t log2_esz, uintptr_t ra)
+                vext_ldst_elem_fn *ldst_elem, uint32_t log2_esz, uintptr_t ra,
+                MMUAccessType access_type)
 {
     uint32_t i, k, off, pos;
     uint32_t nf = vext_nf(desc);
@@ -571,6 +712,8 @@ vext_ldst_whole(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
             target_ulong addr = base + ((pos + k * max_elems) << log2_esz);
             ldst_elem(env, adjust_addr(env, addr), pos + k * max_elems, vd,
                       ra);
+            andes_cache_data(env, adjust_addr(env, addr), 1 << log2_esz,
+                             access_type == MMU_DATA_STORE);
         }
         k++;
     }
@@ -580,6 +723,8 @@ vext_ldst_whole(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
         for (i = 0; i < max_elems; i++, env->vstart++) {
             target_ulong addr = base + ((i + k * max_elems) << log2_esz);
             ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            andes_cache_data(env, adjust_addr(env, addr), 1 << log2_esz,
+                             access_type == MMU_DATA_STORE);
         }
     }
 
@@ -591,7 +736,8 @@ void HELPER(NAME)(void *vd, target_ulong base,       \
                   CPURISCVState *env, uint32_t desc) \
 {                                                    \
     vext_ldst_whole(vd, base, env, desc, LOAD_FN,    \
-                    ctzl(sizeof(ETYPE)), GETPC());   \
+                    ctzl(sizeof(ETYPE)), GETPC(),    \
+                    MMU_DATA_LOAD);                  \
 }
 
 GEN_VEXT_LD_WHOLE(vl1re8_v,  int8_t,  lde_b)
@@ -616,7 +762,8 @@ void HELPER(NAME)(void *vd, target_ulong base,       \
                   CPURISCVState *env, uint32_t desc) \
 {                                                    \
     vext_ldst_whole(vd, base, env, desc, STORE_FN,   \
-                    ctzl(sizeof(ETYPE)), GETPC());   \
+                    ctzl(sizeof(ETYPE)), GETPC(),    \
+                    MMU_DATA_STORE);                 \
 }
 
 GEN_VEXT_ST_WHOLE(vs1r_v, int8_t, ste_b)
@@ -3451,6 +3598,50 @@ void HELPER(NAME)(void *vd, void *v0, void *vs2,       \
                       total_elems * ESZ);              \
 }
 
+/*
+ * The BF16 conversions are done in bulk by softfloat when no element is
+ * masked off.  Elements are in host order only on little-endian hosts.
+ */
+#if HOST_BIG_ENDIAN
+#define vext_bf16_bulk_ok(vm)  false
+#else
+#define vext_bf16_bulk_ok(vm)  (vm)
+#endif
+
+#define GEN_VEXT_V_BF16(NAME, ESZ, TD, T2, BULK)       \
+void HELPER(NAME)(void *vd, void *v0, void *vs2,       \
+                  CPURISCVState *env, uint32_t desc)   \
+{                                                      \
+    uint32_t vm = vext_vm(desc);                       \
+    uint32_t vl = env->vl;                             \
+    uint32_t total_elems =                             \
+        vext_get_total_elems(env, desc, ESZ);          \
+    uint32_t vta = vext_vta(desc);                     \
+    uint32_t vma = vext_vma(desc);                     \
+    uint32_t i = env->vstart;                          \
+                                                       \
+    if (vl == 0) {                                     \
+        return;                                        \
+    }                                                  \
+    if (vext_bf16_bulk_ok(vm) && i < vl) {             \
+        BULK((TD *)vd + i, (T2 *)vs2 + i, vl - i,      \
+             &env->fp_status);                         \
+        i = vl;                                        \
+    }                                                  \
+    for (; i < vl; i++) {                              \
+        if (!vm && !vext_elem_mask(v0, i)) {           \
+            /* set masked-off elements to 1s */        \
+            vext_set_elems_1s(vd, vma, i * ESZ,        \
+                              (i + 1) * ESZ);          \
+            continue;                                  \
+        }                                              \
+        do_##NAME(vd, vs2, i, env);                    \
+    }                                                  \
+    env->vstart = 0;                                   \
+    vext_set_elems_1s(vd, vta, vl * ESZ,               \
+                      total_elems * ESZ);              \
+}
+
 RVVCALL(OPFVV1, vfsqrt_v_h, OP_UU_H, H2, H2, nds_float16_sqrt)
 RVVCALL(OPFVV1, vfsqrt_v_w, OP_UU_W, H4, H4, float32_sqrt)
 RVVCALL(OPFVV1, vfsqrt_v_d, OP_UU_D, H8, H8, float64_sqrt)
@@ -4473,7 +4664,7 @@ GEN_VEXT_V_ENV(vfwcvt_f_f_v_h, 4)
 GEN_VEXT_V_ENV(vfwcvt_f_f_v_w, 8)
 
 RVVCALL(OPFVV1, vfwcvtbf16_f_f_v, WOP_UU_H, H4, H2, bfloat16_to_float32)
-GEN_VEXT_V_ENV(vfwcvtbf16_f_f_v, 4)
+GEN_VEXT_V_BF16(vfwcvtbf16_f_f_v, 4, float32, bfloat16, bfloat16_to_float32_n)
 
 /* Narrowing Floating-Point/Integer Type-Convert Instructions */
 /* (TD, T2, TX2) */
@@ -4522,7 +4713,7 @@ GEN_VEXT_V_ENV(vfncvt_f_f_w_h, 2)
 GEN_VEXT_V_ENV(vfncvt_f_f_w_w, 4)
 
 RVVCALL(OPFVV1, vfncvtbf16_f_f_w, NOP_UU_H, H2, H4, float32_to_bfloat16)
-GEN_VEXT_V_ENV(vfncvtbf16_f_f_w, 2)
+GEN_VEXT_V_BF16(vfncvtbf16_f_f_w, 2, bfloat16, float32, float32_to_bfloat16_n)
 
 /*
  * Vector Reduction Operations
@@ -5361,10 +5552,12 @@ GEN_VEXT_INT4_EXT(vsext_vf8_w, int32_t,  int4_t,  H4, H1, int8_to_int4)
 
 
 RVVCALL(OPFVV1, andes_vfwcvt_s_bf16, WOP_UU_H, H4, H2, bfloat16_to_float32)
-GEN_VEXT_V_ENV(andes_vfwcvt_s_bf16, 4)
+GEN_VEXT_V_BF16(andes_vfwcvt_s_bf16, 4, float32, bfloat16,
+                bfloat16_to_float32_n)
 
 RVVCALL(OPFVV1, andes_vfncvt_bf16_s, NOP_UU_H, H2, H4, float32_to_bfloat16)
-GEN_VEXT_V_ENV(andes_vfncvt_bf16_s, 2)
+GEN_VEXT_V_BF16(andes_vfncvt_bf16_s, 2, bfloat16, float32,
+                float32_to_bfloat16_n)
 
 
 #define OPFVF9(NAME, TD, T1, T2, TX1, TX2, HD, HS1, HS2, OP)                \
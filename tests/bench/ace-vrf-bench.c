@@ -0,0 +1,154 @@
+/*
+ * Compare the copying and the zero-copy ACE vector register file access
+ *
+ * This is a stub ACE agent rather than a program: QEMU loads it like any
+ * other agent, and when a hart registers, it times a vector ACE
+ * instruction vd = vs1 + vs2 done through QEMU's own callbacks, on that
+ * hart's CPU state:
+ *
+ *  - copy: ACE_GET_VRF for the sources, ACE_SET_VRF for the result
+ *  - view: ACE_GET_VRF_VIEW for all three registers, in place
+ *
+ * It then prints the figures and exits, e.g.
+ *
+ *   qemu-system-riscv64 -M andes_ae350 -display none -S \
+ *       -cpu andes-ax45mpv,xandesace=true,vlen=1024,\
+ *            xandesacelib=tests/bench/libace-vrf-bench.so
+ *
+ * ACE_VRF_BENCH_ITERATIONS in the environment sets the number of
+ * instructions (default 1000000).
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ace-helper.h"
+
+#define NUM_VREGS 32
+
+static AceAgentFuncPtr *cb;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void vadd(uint8_t *d, const uint8_t *a, const uint8_t *b,
+                 uint32_t vlenb)
+{
+    uint32_t i;
+
+    for (i = 0; i < vlenb; i++) {
+        d[i] = a[i] + b[i];
+    }
+}
+
+static void run_copy(void *env, uint8_t *s1, uint8_t *s2, uint8_t *d,
+                     uint32_t vlenb, unsigned long iterations)
+{
+    unsigned long i;
+
+    for (i = 0; i < iterations; i++) {
+        uint32_t vd = i % NUM_VREGS;
+
+        /* ACE_GET_VRF returns QEMU's own storage, the agent copies it */
+        memcpy(s1, FUNC_1V(cb[ACE_GET_VRF], env, (vd + 1) % NUM_VREGS),
+               vlenb);
+        memcpy(s2, FUNC_1V(cb[ACE_GET_VRF], env, (vd + 2) % NUM_VREGS),
+               vlenb);
+        vadd(d, s1, s2, vlenb);
+        FUNC_2V(cb[ACE_SET_VRF], env, vd, d);
+    }
+}
+
+static int run_view(void *env, uint32_t vlenb, unsigned long iterations)
+{
+    AceVrfView d = { .version = ACE_VRF_VIEW_VERSION };
+    AceVrfView s1 = { .version = ACE_VRF_VIEW_VERSION };
+    AceVrfView s2 = { .version = ACE_VRF_VIEW_VERSION };
+    unsigned long i;
+
+    for (i = 0; i < iterations; i++) {
+        uint32_t vd = i % NUM_VREGS;
+
+        if (FUNC_3VV(cb[ACE_GET_VRF_VIEW], env, (vd + 1) % NUM_VREGS,
+                     ACE_MEM_READ, &s1) ||
+            FUNC_3VV(cb[ACE_GET_VRF_VIEW], env, (vd + 2) % NUM_VREGS,
+                     ACE_MEM_READ, &s2) ||
+            FUNC_3VV(cb[ACE_GET_VRF_VIEW], env, vd, ACE_MEM_WRITE, &d)) {
+            return -1;
+        }
+        vadd(d.data, s1.data, s2.data, vlenb);
+    }
+    return 0;
+}
+
+static int run_bench(void *env)
+{
+    AceVrfView probe = { .version = ACE_VRF_VIEW_VERSION };
+    const char *s = getenv("ACE_VRF_BENCH_ITERATIONS");
+    unsigned long iterations = s ? strtoul(s, NULL, 0) : 1000000;
+    int64_t start, copy_ns, view_ns;
+    uint8_t *s1, *s2, *d;
+    uint32_t vlenb;
+
+    if (FUNC_3VV(cb[ACE_GET_VRF_VIEW], env, 0, ACE_MEM_READ, &probe)) {
+        fprintf(stderr, "ace-vrf-bench: ACE_GET_VRF_VIEW failed\n");
+        return -1;
+    }
+    vlenb = probe.vlenb;
+    s1 = malloc(vlenb);
+    s2 = malloc(vlenb);
+    d = malloc(vlenb);
+
+    start = now_ns();
+    run_copy(env, s1, s2, d, vlenb, iterations);
+    copy_ns = now_ns() - start;
+
+    start = now_ns();
+    if (run_view(env, vlenb, iterations)) {
+        fprintf(stderr, "ace-vrf-bench: ACE_GET_VRF_VIEW failed\n");
+        return -1;
+    }
+    view_ns = now_ns() - start;
+
+    printf("VLEN %5" PRIu32 ": copy %8.2f ns/insn, view %8.2f ns/insn, "
+           "speedup %.2fx\n", vlenb * 8,
+           (double)copy_ns / iterations, (double)view_ns / iterations,
+           view_ns ? (double)copy_ns / view_ns : 0.0);
+
+    free(d);
+    free(s2);
+    free(s1);
+    return 0;
+}
+
+int32_t ace_agent_version(void *env)
+{
+    return ACE_AGENT_VERSION;
+}
+
+int32_t ace_agent_register(void *env, AceAgentFuncPtr *table,
+                           uint32_t count, const char *extlibpath,
+                           uint64_t hartid, int32_t multi)
+{
+    if (count <= ACE_GET_VRF_VIEW) {
+        fprintf(stderr, "ace-vrf-bench: QEMU lacks ACE_GET_VRF_VIEW\n");
+        exit(1);
+    }
+    cb = table;
+    exit(run_bench(env) ? 1 : 0);
+}
+
+int32_t ace_agent_run_insn(void *env, uint32_t opcode, uint64_t hartid)
+{
+    return 1;
+}
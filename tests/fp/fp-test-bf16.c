@@ -0,0 +1,159 @@
+/*
+ * fp-test-bf16.c - check the bulk float32 <-> bfloat16 conversions
+ *
+ * The bulk conversions must give the same results and raise the same
+ * flags as float32_to_bfloat16() and bfloat16_to_float32(), for every
+ * bfloat16 value and for every float32 upper half combined with the
+ * lower halves that decide the rounding.
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#ifndef HW_POISON_H
+#error Must define HW_POISON_H to work around TARGET_* poisoning
+#endif
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+
+#define NUM_HALVES  (1 << 16)
+#define BLOCK       16
+
+static const FloatRoundMode round_modes[] = {
+    float_round_nearest_even,
+    float_round_down,
+    float_round_up,
+    float_round_to_zero,
+    float_round_ties_away,
+    float_round_to_odd,
+};
+
+/* Lower halves around the rounding boundaries, and a few others */
+static const uint16_t low_halves[] = {
+    0x0000, 0x0001, 0x7fff, 0x8000, 0x8001, 0xffff, 0x1234, 0xc0de,
+};
+
+static int errors;
+
+/* @ftz: bit 0 flushes denormal inputs, bit 1 denormal outputs */
+static void init_status(float_status *st, FloatRoundMode mode, bool dnan,
+                        int ftz)
+{
+    memset(st, 0, sizeof(*st));
+    set_float_rounding_mode(mode, st);
+    set_default_nan_mode(dnan, st);
+    set_flush_inputs_to_zero(ftz & 1, st);
+    set_flush_to_zero(ftz & 2, st);
+}
+
+static void check(const char *what, uint32_t in, uint32_t got, uint32_t exp,
+                  int got_flags, int exp_flags, FloatRoundMode mode)
+{
+    if (got == exp && got_flags == exp_flags) {
+        return;
+    }
+    printf("%s %#010x rm %d: got %#010x flags %#x, "
+           "expected %#010x flags %#x\n",
+           what, in, mode, got, got_flags, exp, exp_flags);
+    errors++;
+}
+
+/* Convert every block on its own too, so that flags are checked per block */
+static void test_narrow(float32 *in, size_t n, FloatRoundMode mode,
+                        bool dnan, int ftz)
+{
+    g_autofree bfloat16 *out = g_new(bfloat16, n);
+    float_status bulk, scalar;
+    size_t i, j;
+
+    init_status(&bulk, mode, dnan, ftz);
+    float32_to_bfloat16_n(out, in, n, &bulk);
+
+    init_status(&scalar, mode, dnan, ftz);
+    for (i = 0; i < n; i++) {
+        check("f32->bf16", float32_val(in[i]), out[i],
+              float32_to_bfloat16(in[i], &scalar), 0, 0, mode);
+    }
+    check("f32->bf16 all", 0, 0, 0, get_float_exception_flags(&bulk),
+          get_float_exception_flags(&scalar), mode);
+
+    for (i = 0; i + BLOCK <= n; i += BLOCK) {
+        init_status(&bulk, mode, dnan, ftz);
+        float32_to_bfloat16_n(out + i, in + i, BLOCK, &bulk);
+        init_status(&scalar, mode, dnan, ftz);
+        for (j = i; j < i + BLOCK; j++) {
+            float32_to_bfloat16(in[j], &scalar);
+        }
+        check("f32->bf16 block", float32_val(in[i]), 0, 0,
+              get_float_exception_flags(&bulk),
+              get_float_exception_flags(&scalar), mode);
+    }
+}
+
+static void test_widen(bfloat16 *in, size_t n, FloatRoundMode mode,
+                       bool dnan, int ftz)
+{
+    g_autofree float32 *out = g_new(float32, n);
+    float_status bulk, scalar;
+    size_t i, j;
+
+    init_status(&bulk, mode, dnan, ftz);
+    bfloat16_to_float32_n(out, in, n, &bulk);
+
+    init_status(&scalar, mode, dnan, ftz);
+    for (i = 0; i < n; i++) {
+        check("bf16->f32", in[i], float32_val(out[i]),
+              float32_val(bfloat16_to_float32(in[i], &scalar)), 0, 0, mode);
+    }
+    check("bf16->f32 all", 0, 0, 0, get_float_exception_flags(&bulk),
+          get_float_exception_flags(&scalar), mode);
+
+    for (i = 0; i + BLOCK <= n; i += BLOCK) {
+        init_status(&bulk, mode, dnan, ftz);
+        bfloat16_to_float32_n(out + i, in + i, BLOCK, &bulk);
+        init_status(&scalar, mode, dnan, ftz);
+        for (j = i; j < i + BLOCK; j++) {
+            bfloat16_to_float32(in[j], &scalar);
+        }
+        check("bf16->f32 block", in[i], 0, 0,
+              get_float_exception_flags(&bulk),
+              get_float_exception_flags(&scalar), mode);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    g_autofree float32 *f32 = g_new(float32, NUM_HALVES);
+    g_autofree bfloat16 *bf16 = g_new(bfloat16, NUM_HALVES);
+    size_t i, m, l;
+    int flags;
+
+    for (i = 0; i < NUM_HALVES; i++) {
+        bf16[i] = i;
+    }
+
+    for (flags = 0; flags < 8; flags++) {
+        bool dnan = flags & 1;
+        int ftz = flags >> 1;
+
+        for (m = 0; m < ARRAY_SIZE(round_modes); m++) {
+            /* All of them, and an odd length to take the scalar tail */
+            test_widen(bf16, NUM_HALVES, round_modes[m], dnan, ftz);
+            test_widen(bf16 + 3, NUM_HALVES - 8, round_modes[m], dnan, ftz);
+
+            for (l = 0; l < ARRAY_SIZE(low_halves); l++) {
+                for (i = 0; i < NUM_HALVES; i++) {
+                    f32[i] = make_float32((i << 16) | low_halves[l]);
+                }
+                test_narrow(f32, NUM_HALVES, round_modes[m], dnan, ftz);
+                test_narrow(f32 + 3, NUM_HALVES - 8, round_modes[m],
+                            dnan, ftz);
+            }
+        }
+    }
+
+    if (errors) {
+        printf("%d errors\n", errors);
+    }
+    return errors != 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * QTest testcase for the Andes PLIC of the AE350 platform
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2 or later, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+
+#define PLIC_BASE           0xe4000000
+#define PLIC_PRIORITY(irq)  (PLIC_BASE + 4 * (irq))
+#define PLIC_PENDING(irq)   (PLIC_BASE + 0x1000 + 4 * ((irq) / 32))
+#define PLIC_ENABLE(ctx, irq) \
+    (PLIC_BASE + 0x2000 + 0x80 * (ctx) + 4 * ((irq) / 32))
+#define PLIC_THRESHOLD(ctx) (PLIC_BASE + 0x200000 + 0x1000 * (ctx))
+#define PLIC_CLAIM(ctx)     (PLIC_THRESHOLD(ctx) + 4)
+#define PLIC_NUM_SOURCES    128
+
+#define NUM_HARTS           8
+/* Contexts are "MS" per hart */
+#define CTX_M(hart)         (2 * (hart))
+#define CTX_S(hart)         (2 * (hart) + 1)
+/* Intercepted outputs: S external IRQs first, then M */
+#define OUT_S(hart)         (hart)
+#define OUT_M(hart)         (NUM_HARTS + (hart))
+
+#define TEST_IRQ            5
+
+static char *find_plic(QTestState *qts)
+{
+    QDict *resp;
+    QListEntry *e;
+    char *path = NULL;
+
+    resp = qtest_qmp(qts, "{ 'execute': 'qom-list',"
+                     " 'arguments': { 'path': '/machine/unattached' } }");
+    g_assert(qdict_haskey(resp, "return"));
+
+    QLIST_FOREACH_ENTRY(qdict_get_qlist(resp, "return"), e) {
+        QDict *child = qobject_to(QDict, qlist_entry_obj(e));
+        char *candidate;
+        QDict *name;
+
+        if (strcmp(qdict_get_str(child, "type"), "child<riscv.andes.plic>")) {
+            continue;
+        }
+        candidate = g_strdup_printf("/machine/unattached/%s",
+                                    qdict_get_str(child, "name"));
+        name = qtest_qmp(qts, "{ 'execute': 'qom-get', 'arguments':"
+                         " { 'path': %s, 'property': 'plic-name' } }",
+                         candidate);
+        if (!strcmp(qdict_get_str(name, "return"), "ANDES_PLIC")) {
+            path = candidate;
+        } else {
+            g_free(candidate);
+        }
+        qobject_unref(name);
+        if (path) {
+            break;
+        }
+    }
+    qobject_unref(resp);
+
+    g_assert(path);
+    return path;
+}
+
+static QTestState *plic_start(char **path)
+{
+    QTestState *qts;
+
+    qts = qtest_initf("-machine andes_ae350 -smp %d -bios none", NUM_HARTS);
+    *path = find_plic(qts);
+    qtest_irq_intercept_out(qts, *path);
+    return qts;
+}
+
+static void plic_enable(QTestState *qts, int ctx, int irq, bool on)
+{
+    uint32_t val = qtest_readl(qts, PLIC_ENABLE(ctx, irq));
+
+    if (on) {
+        val |= 1u << (irq % 32);
+    } else {
+        val &= ~(1u << (irq % 32));
+    }
+    qtest_writel(qts, PLIC_ENABLE(ctx, irq), val);
+}
+
+/* Only the targets that have the source enabled see it */
+static void test_delivery(void)
+{
+    QTestState *qts;
+    char *path;
+
+    qts = plic_start(&path);
+
+    qtest_writel(qts, PLIC_PRIORITY(TEST_IRQ), 1);
+    plic_enable(qts, CTX_M(0), TEST_IRQ, true);
+    plic_enable(qts, CTX_S(3), TEST_IRQ, true);
+
+    qtest_set_irq_in(qts, path, NULL, TEST_IRQ, 1);
+    g_assert_cmpuint(qtest_readl(qts, PLIC_PENDING(TEST_IRQ)) &
+                     (1u << (TEST_IRQ % 32)), !=, 0);
+    g_assert_true(qtest_get_irq(qts, OUT_M(0)));
+    g_assert_true(qtest_get_irq(qts, OUT_S(3)));
+    g_assert_false(qtest_get_irq(qts, OUT_M(1)));
+    g_assert_false(qtest_get_irq(qts, OUT_S(0)));
+
+    /* Claiming drops the line of every target */
+    g_assert_cmpuint(qtest_readl(qts, PLIC_CLAIM(CTX_M(0))), ==, TEST_IRQ);
+    g_assert_false(qtest_get_irq(qts, OUT_M(0)));
+    g_assert_false(qtest_get_irq(qts, OUT_S(3)));
+
+    /* Level triggered, so completing while still raised pends it again */
+    qtest_writel(qts, PLIC_CLAIM(CTX_M(0)), TEST_IRQ);
+    g_assert_true(qtest_get_irq(qts, OUT_M(0)));
+    g_assert_true(qtest_get_irq(qts, OUT_S(3)));
+
+    qtest_set_irq_in(qts, path, NULL, TEST_IRQ, 0);
+    g_assert_false(qtest_get_irq(qts, OUT_M(0)));
+    g_assert_false(qtest_get_irq(qts, OUT_S(3)));
+
+    /* A disabled target is no longer evaluated */
+    plic_enable(qts, CTX_S(3), TEST_IRQ, false);
+    qtest_set_irq_in(qts, path, NULL, TEST_IRQ, 1);
+    g_assert_true(qtest_get_irq(qts, OUT_M(0)));
+    g_assert_false(qtest_get_irq(qts, OUT_S(3)));
+
+    g_free(path);
+    qtest_quit(qts);
+}
+
+/* A source with priority 0 never interrupts */
+static void test_priority(void)
+{
+    QTestState *qts;
+    char *path;
+
+    qts = plic_start(&path);
+
+    plic_enable(qts, CTX_M(2), TEST_IRQ, true);
+    qtest_set_irq_in(qts, path, NULL, TEST_IRQ, 1);
+    g_assert_false(qtest_get_irq(qts, OUT_M(2)));
+
+    qtest_writel(qts, PLIC_PRIORITY(TEST_IRQ), 3);
+    g_assert_true(qtest_get_irq(qts, OUT_M(2)));
+
+    /* Threshold at or above the priority masks it */
+    qtest_writel(qts, PLIC_THRESHOLD(CTX_M(2)), 3);
+    g_assert_false(qtest_get_irq(qts, OUT_M(2)));
+    qtest_writel(qts, PLIC_THRESHOLD(CTX_M(2)), 0);
+    g_assert_true(qtest_get_irq(qts, OUT_M(2)));
+
+    qtest_writel(qts, PLIC_PRIORITY(TEST_IRQ), 0);
+    g_assert_false(qtest_get_irq(qts, OUT_M(2)));
+
+    g_free(path);
+    qtest_quit(qts);
+}
+
+/*
+ * IRQ storm: every source enabled on one target each, raised, claimed,
+ * completed and lowered in turn.  Run with -m perf.
+ */
+static void test_irq_storm(void)
+{
+    const int rounds = 200;
+    QTestState *qts;
+    char *path;
+    int64_t start;
+    double elapsed;
+    int irq, ctx, i;
+
+    qts = plic_start(&path);
+
+    for (irq = 1; irq < PLIC_NUM_SOURCES; irq++) {
+        qtest_writel(qts, PLIC_PRIORITY(irq), 1);
+        plic_enable(qts, irq % (2 * NUM_HARTS), irq, true);
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++) {
+        for (irq = 1; irq < PLIC_NUM_SOURCES; irq++) {
+            ctx = irq % (2 * NUM_HARTS);
+            qtest_set_irq_in(qts, path, NULL, irq, 1);
+            g_assert_cmpuint(qtest_readl(qts, PLIC_CLAIM(ctx)), ==, irq);
+            qtest_set_irq_in(qts, path, NULL, irq, 0);
+            qtest_writel(qts, PLIC_CLAIM(ctx), irq);
+        }
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    g_test_minimized_result(elapsed / (rounds * (PLIC_NUM_SOURCES - 1)),
+                            "%.2f us per interrupt",
+                            elapsed / (rounds * (PLIC_NUM_SOURCES - 1)));
+
+    g_free(path);
+    qtest_quit(qts);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/andes-plic/delivery", test_delivery);
+    qtest_add_func("/andes-plic/priority", test_priority);
+    if (g_test_perf()) {
+        qtest_add_func("/andes-plic/irq-storm", test_irq_storm);
+    }
+
+    return g_test_run();
+}
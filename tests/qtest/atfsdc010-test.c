@@ -0,0 +1,273 @@
+/*
+ * QTest testcase for the ATFSDC010 SD controller in DMA mode
+ *
+ * Multi-block reads and writes are moved both through the data window by
+ * the CPU and by the ATCDMAC300 of the AE350 board.
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define SDC_BASE            0xf0e00000
+#define SDC_CMD             (SDC_BASE + 0x00)
+#define SDC_ARG             (SDC_BASE + 0x04)
+#define SDC_RESP0           (SDC_BASE + 0x08)
+#define SDC_DATACTRL        (SDC_BASE + 0x1c)
+#define SDC_DATALENGTH      (SDC_BASE + 0x24)
+#define SDC_STATUS          (SDC_BASE + 0x28)
+#define SDC_CLEAR           (SDC_BASE + 0x2c)
+#define SDC_DATA            (SDC_BASE + 0x40)
+
+#define CMD_RESPONSE        (1 << 6)
+#define CMD_LONGRESP        (1 << 7)
+#define CMD_ENABLE          (1 << 9)
+
+#define DATA_WRITE          (1 << 4)
+#define DATA_DMAENABLE      (1 << 5)
+#define DATA_ENABLE         (1 << 6)
+
+#define STATUS_CMDTIMEOUT   (1 << 2)
+#define STATUS_DATAEND      (1 << 7)
+#define STATUS_FIFO_URUN    (1 << 8)
+#define STATUS_FIFO_ORUN    (1 << 9)
+
+#define DMAC_BASE           0xf0c00000
+#define DMAC_INT_STATUS     (DMAC_BASE + 0x30)
+#define DMAC_CH0_CTL        (DMAC_BASE + 0x40)
+#define DMAC_CH0_TRAN_SZ    (DMAC_BASE + 0x44)
+#define DMAC_CH0_SRC        (DMAC_BASE + 0x48)
+#define DMAC_CH0_SRC_H      (DMAC_BASE + 0x4c)
+#define DMAC_CH0_DST        (DMAC_BASE + 0x50)
+#define DMAC_CH0_DST_H      (DMAC_BASE + 0x54)
+#define DMAC_CH0_LLP        (DMAC_BASE + 0x58)
+#define DMAC_CH0_LLP_H      (DMAC_BASE + 0x5c)
+
+/* 32-bit elements, interrupts masked, enabled */
+#define DMAC_CTL_WORD       ((2 << 21) | (2 << 18) | (0xe << 0) | 1)
+#define DMAC_CTL_SRC_FIXED  (2 << 14)
+#define DMAC_CTL_DST_FIXED  (2 << 12)
+#define DMAC_INT_TC0        (1 << 16)
+#define DMAC_INT_ERR0       (1 << 0)
+
+#define RAM_BUF             0x100000
+
+#define BLOCK_SIZE          512
+#define NUM_BLOCKS          4
+#define XFER_SIZE           (NUM_BLOCKS * BLOCK_SIZE)
+#define IMAGE_SIZE          (1 << 20)
+
+static char *sd_path;
+
+static uint32_t sd_cmd(QTestState *qts, int index, uint32_t arg,
+                       uint32_t flags)
+{
+    qtest_writel(qts, SDC_CLEAR, 0x7ff);
+    qtest_writel(qts, SDC_ARG, arg);
+    qtest_writel(qts, SDC_CMD, index | flags | CMD_ENABLE);
+    g_assert_false(qtest_readl(qts, SDC_STATUS) & STATUS_CMDTIMEOUT);
+    return qtest_readl(qts, SDC_RESP0);
+}
+
+static QTestState *setup_sd_card(void)
+{
+    QTestState *qts;
+    uint32_t rca;
+
+    qts = qtest_initf("-machine andes_ae350 -bios none "
+                      "-drive if=sd,file=%s,format=raw", sd_path);
+
+    sd_cmd(qts, 0, 0, 0);
+    sd_cmd(qts, 55, 0, CMD_RESPONSE);
+    sd_cmd(qts, 41, 0x41200000, CMD_RESPONSE);
+    sd_cmd(qts, 2, 0, CMD_RESPONSE | CMD_LONGRESP);
+    rca = sd_cmd(qts, 3, 0, CMD_RESPONSE) >> 16;
+    sd_cmd(qts, 7, rca << 16, CMD_RESPONSE);
+    return qts;
+}
+
+/* Poll until the bottom half moving the data has set the status bits */
+static void wait_status(QTestState *qts, uint32_t bits)
+{
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        if (qtest_readl(qts, SDC_STATUS) & bits) {
+            break;
+        }
+    }
+    g_assert_cmphex(qtest_readl(qts, SDC_STATUS) & bits, ==, bits);
+}
+
+static void fill_pattern(uint8_t *buf, size_t len, uint8_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = seed + i * 7 + (i >> 9);
+    }
+}
+
+static void image_write(const uint8_t *buf, off_t offset, size_t len)
+{
+    int fd = open(sd_path, O_WRONLY);
+
+    g_assert(fd >= 0);
+    g_assert_cmpint(pwrite(fd, buf, len, offset), ==, len);
+    close(fd);
+}
+
+static void image_read(uint8_t *buf, off_t offset, size_t len)
+{
+    int fd = open(sd_path, O_RDONLY);
+
+    g_assert(fd >= 0);
+    g_assert_cmpint(pread(fd, buf, len, offset), ==, len);
+    close(fd);
+}
+
+/* Run channel 0 between the data window and RAM_BUF, wait for it */
+static void dmac_run(QTestState *qts, bool to_card)
+{
+    uint32_t done = DMAC_INT_TC0 | DMAC_INT_ERR0;
+    int i;
+
+    qtest_writel(qts, DMAC_INT_STATUS, 0xffffffff);
+    qtest_writel(qts, DMAC_CH0_TRAN_SZ, XFER_SIZE / 4);
+    qtest_writel(qts, DMAC_CH0_SRC, to_card ? RAM_BUF : SDC_DATA);
+    qtest_writel(qts, DMAC_CH0_SRC_H, 0);
+    qtest_writel(qts, DMAC_CH0_DST, to_card ? SDC_DATA : RAM_BUF);
+    qtest_writel(qts, DMAC_CH0_DST_H, 0);
+    qtest_writel(qts, DMAC_CH0_LLP, 0);
+    qtest_writel(qts, DMAC_CH0_LLP_H, 0);
+    qtest_writel(qts, DMAC_CH0_CTL, DMAC_CTL_WORD |
+                 (to_card ? DMAC_CTL_DST_FIXED : DMAC_CTL_SRC_FIXED));
+
+    for (i = 0; i < 1000; i++) {
+        if (qtest_readl(qts, DMAC_INT_STATUS) & done) {
+            break;
+        }
+    }
+    g_assert_cmphex(qtest_readl(qts, DMAC_INT_STATUS), ==, DMAC_INT_TC0);
+}
+
+static void do_read(bool use_dmac)
+{
+    g_autofree uint8_t *expected = g_malloc(XFER_SIZE);
+    g_autofree uint8_t *data = g_malloc(XFER_SIZE);
+    QTestState *qts;
+    uint32_t value;
+    int i;
+
+    fill_pattern(expected, XFER_SIZE, use_dmac ? 0x11 : 0x22);
+    image_write(expected, BLOCK_SIZE, XFER_SIZE);
+
+    qts = setup_sd_card();
+    qtest_writel(qts, SDC_DATALENGTH, XFER_SIZE);
+    qtest_writel(qts, SDC_DATACTRL, DATA_ENABLE | DATA_DMAENABLE);
+    sd_cmd(qts, 18, BLOCK_SIZE, CMD_RESPONSE);
+
+    if (use_dmac) {
+        dmac_run(qts, false);
+        qtest_memread(qts, RAM_BUF, data, XFER_SIZE);
+    } else {
+        /* The first chunk is staged once the card has data */
+        wait_status(qts, STATUS_FIFO_ORUN);
+        for (i = 0; i < XFER_SIZE; i += 4) {
+            value = qtest_readl(qts, SDC_DATA);
+            memcpy(data + i, &value, 4);
+        }
+        g_assert_cmphex(qtest_readl(qts, SDC_DATACTRL) & DATA_ENABLE, ==, 0);
+    }
+    wait_status(qts, STATUS_DATAEND);
+    sd_cmd(qts, 12, 0, CMD_RESPONSE);
+
+    g_assert_cmpmem(data, XFER_SIZE, expected, XFER_SIZE);
+    qtest_quit(qts);
+}
+
+static void do_write(bool use_dmac)
+{
+    g_autofree uint8_t *expected = g_malloc(XFER_SIZE);
+    g_autofree uint8_t *data = g_malloc(XFER_SIZE);
+    QTestState *qts;
+    uint32_t value;
+    int i;
+
+    fill_pattern(expected, XFER_SIZE, use_dmac ? 0x33 : 0x44);
+
+    qts = setup_sd_card();
+    sd_cmd(qts, 25, 2 * BLOCK_SIZE, CMD_RESPONSE);
+    qtest_writel(qts, SDC_DATALENGTH, XFER_SIZE);
+    qtest_writel(qts, SDC_DATACTRL,
+                 DATA_ENABLE | DATA_DMAENABLE | DATA_WRITE);
+    g_assert_true(qtest_readl(qts, SDC_STATUS) & STATUS_FIFO_URUN);
+
+    if (use_dmac) {
+        qtest_memwrite(qts, RAM_BUF, expected, XFER_SIZE);
+        dmac_run(qts, true);
+    } else {
+        for (i = 0; i < XFER_SIZE; i += 4) {
+            memcpy(&value, expected + i, 4);
+            qtest_writel(qts, SDC_DATA, value);
+        }
+    }
+    wait_status(qts, STATUS_DATAEND);
+    g_assert_cmphex(qtest_readl(qts, SDC_DATACTRL) & DATA_ENABLE, ==, 0);
+    sd_cmd(qts, 12, 0, CMD_RESPONSE);
+    qtest_quit(qts);
+
+    image_read(data, 2 * BLOCK_SIZE, XFER_SIZE);
+    g_assert_cmpmem(data, XFER_SIZE, expected, XFER_SIZE);
+}
+
+static void test_read_window(void)
+{
+    do_read(false);
+}
+
+static void test_read_dmac(void)
+{
+    do_read(true);
+}
+
+static void test_write_window(void)
+{
+    do_write(false);
+}
+
+static void test_write_dmac(void)
+{
+    do_write(true);
+}
+
+static void drive_create(void)
+{
+    GError *error = NULL;
+    int fd;
+
+    fd = g_file_open_tmp("atfsdc010_XXXXXX", &sd_path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(ftruncate(fd, IMAGE_SIZE), ==, 0);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    drive_create();
+
+    g_test_init(&argc, &argv, NULL);
+    qtest_add_func("atfsdc010/dma/read/window", test_read_window);
+    qtest_add_func("atfsdc010/dma/read/dmac", test_read_dmac);
+    qtest_add_func("atfsdc010/dma/write/window", test_write_window);
+    qtest_add_func("atfsdc010/dma/write/dmac", test_write_dmac);
+    ret = g_test_run();
+
+    unlink(sd_path);
+    g_free(sd_path);
+    return ret;
+}
@@ -0,0 +1,256 @@
+/*
+ * Check the Andes V5 byte search and bit-field instructions against a
+ * reference model of their semantics.
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARRAY_SIZE(X)  (sizeof(X) / sizeof(*(X)))
+
+enum {
+    FFB = 0x10,
+    FFZMISM = 0x11,
+    FFMISM = 0x12,
+    FLMISM = 0x13,
+};
+
+static uint64_t rng = 0x9e3779b97f4a7c15ull;
+
+static uint64_t next(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* Bias the bytes towards the values that trip up carry based tricks */
+static uint64_t next_value(void)
+{
+    static const uint8_t special[] = { 0x00, 0x01, 0x7f, 0x80, 0xfe, 0xff };
+    uint64_t r = next();
+    uint64_t v = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        uint8_t b = r >> (8 * i);
+
+        if (b & 1) {
+            b = special[(b >> 1) % ARRAY_SIZE(special)];
+        }
+        v |= (uint64_t)b << (8 * i);
+    }
+    return v;
+}
+
+static uint8_t byte(uint64_t v, int i)
+{
+    return v >> (8 * i);
+}
+
+static int64_t ref_find(uint64_t a, uint64_t b, int op)
+{
+    int i;
+
+    switch (op) {
+    case FFB:
+        for (i = 0; i < 8; i++) {
+            if (byte(a, i) == byte(b, 0)) {
+                return i - 8;
+            }
+        }
+        break;
+    case FFZMISM:
+        for (i = 0; i < 8; i++) {
+            if (byte(a, i) == 0 || byte(a, i) != byte(b, i)) {
+                return i - 8;
+            }
+        }
+        break;
+    case FFMISM:
+        for (i = 0; i < 8; i++) {
+            if (byte(a, i) != byte(b, i)) {
+                return i - 8;
+            }
+        }
+        break;
+    case FLMISM:
+        for (i = 7; i >= 0; i--) {
+            if (byte(a, i) != byte(b, i)) {
+                return i - 8;
+            }
+        }
+        break;
+    }
+    return 0;
+}
+
+static int64_t run_find(uint64_t a, uint64_t b, int op)
+{
+    int64_t rd;
+
+    switch (op) {
+    case FFB:
+        asm(".insn r 0x5b, 0, 0x10, %0, %1, %2" : "=r"(rd) : "r"(a), "r"(b));
+        break;
+    case FFZMISM:
+        asm(".insn r 0x5b, 0, 0x11, %0, %1, %2" : "=r"(rd) : "r"(a), "r"(b));
+        break;
+    case FFMISM:
+        asm(".insn r 0x5b, 0, 0x12, %0, %1, %2" : "=r"(rd) : "r"(a), "r"(b));
+        break;
+    default:
+        asm(".insn r 0x5b, 0, 0x13, %0, %1, %2" : "=r"(rd) : "r"(a), "r"(b));
+        break;
+    }
+    return rd;
+}
+
+/* As QEMU's deposit64(), with a zero @length doing nothing */
+static uint64_t deposit64(uint64_t value, int start, int length,
+                          uint64_t fieldval)
+{
+    uint64_t mask;
+
+    if (length == 0) {
+        return value;
+    }
+    mask = (~0ull >> (64 - length)) << start;
+    return (value & ~mask) | ((fieldval << start) & mask);
+}
+
+/* Port of the removed helper_andes_v5_bfo_x(), which sets all of rd */
+static uint64_t ref_bfo(uint64_t rs1, int msb, int lsb, int is_se)
+{
+    int lsbp1, msbm1, lsbm1, lenm1;
+    uint64_t se;
+    uint64_t nxrd = 0;
+
+    lsbp1 = lsb + 1;
+    msbm1 = msb - 1;
+    lsbm1 = lsb - 1;
+
+    if (msb == 0) {
+        nxrd = deposit64(nxrd, lsb, 1, 1 & rs1);
+        if (lsb > 0) {
+            nxrd = deposit64(nxrd, 0, lsbm1 + 1, 0);
+        }
+        if (lsb < 63) {
+            se = (is_se && (1 & rs1)) ? -1LL : 0;
+            nxrd = deposit64(nxrd, lsbp1, 64 - lsbp1, se);
+        }
+    } else if (msb < lsb) {
+        lenm1 = lsb - msb;
+        nxrd = deposit64(nxrd, msb, lenm1 + 1, rs1 >> 0);
+        if (lsb < 63) {
+            se = (is_se && (1 & (rs1 >> lenm1))) ? -1LL : 0;
+            nxrd = deposit64(nxrd, lsbp1, 64 - lsbp1, se);
+        }
+        nxrd = deposit64(nxrd, 0, msbm1 + 1, 0);
+    } else { /* msb >= lsb */
+        lenm1 = msb - lsb;
+        nxrd = deposit64(nxrd, 0, lenm1 + 1, rs1 >> lsb);
+        se = (is_se && (1 & (rs1 >> msb))) ? -1LL : 0;
+        nxrd = deposit64(nxrd, lenm1 + 1, 63 - lenm1, se);
+    }
+
+    return nxrd;
+}
+
+/* bfos is funct3 3, bfoz funct3 2, with imm[11:6] = msb, imm[5:0] = lsb */
+#define BFO_IMM(MSB, LSB)   (((((MSB) << 6) | (LSB)) ^ 0x800) - 0x800)
+
+#define BFO_CASES(X) \
+    X(0, 0) X(0, 1) X(0, 31) X(0, 63) \
+    X(1, 2) X(3, 17) X(8, 63) X(31, 32) X(62, 63) \
+    X(7, 0) X(15, 8) X(31, 0) X(47, 16) X(62, 1) X(63, 1) X(63, 0) \
+    X(5, 5) X(63, 63) X(32, 32)
+
+#define BFO_RUN(MSB, LSB)                                               \
+    if (msb == (MSB) && lsb == (LSB)) {                                 \
+        if (is_se) {                                                    \
+            asm(".insn i 0x5b, 3, %0, %1, %2"                           \
+                : "=r"(rd) : "r"(rs1), "i"(BFO_IMM(MSB, LSB)));         \
+        } else {                                                        \
+            asm(".insn i 0x5b, 2, %0, %1, %2"                           \
+                : "=r"(rd) : "r"(rs1), "i"(BFO_IMM(MSB, LSB)));         \
+        }                                                               \
+        return rd;                                                      \
+    }
+
+static uint64_t run_bfo(uint64_t rs1, int msb, int lsb, int is_se)
+{
+    uint64_t rd;
+
+    BFO_CASES(BFO_RUN)
+    abort();
+}
+
+#define BFO_PAIR(MSB, LSB) { MSB, LSB },
+
+static const struct {
+    int msb, lsb;
+} bfo_cases[] = {
+    BFO_CASES(BFO_PAIR)
+};
+
+int main(void)
+{
+    int err = 0;
+    int i, j, op, se;
+
+    for (i = 0; i < 100000; i++) {
+        uint64_t a = next_value();
+        uint64_t b;
+
+        /* Mostly equal operands, so that the hits land on every byte */
+        switch (i % 3) {
+        case 0:
+            b = next_value();
+            break;
+        case 1:
+            b = a ^ (next_value() & next_value() & next_value());
+            break;
+        default:
+            b = a;
+            break;
+        }
+
+        for (op = FFB; op <= FLMISM; op++) {
+            int64_t expect = ref_find(a, b, op);
+            int64_t got = run_find(a, b, op);
+
+            if (got != expect) {
+                printf("op %#x rs1 %#018llx rs2 %#018llx: "
+                       "got %lld, expected %lld\n", op,
+                       (unsigned long long)a, (unsigned long long)b,
+                       (long long)got, (long long)expect);
+                err = 1;
+            }
+        }
+
+        for (j = 0; j < ARRAY_SIZE(bfo_cases); j++) {
+            for (se = 0; se < 2; se++) {
+                int msb = bfo_cases[j].msb;
+                int lsb = bfo_cases[j].lsb;
+                uint64_t expect = ref_bfo(a, msb, lsb, se);
+                uint64_t got = run_bfo(a, msb, lsb, se);
+
+                if (got != expect) {
+                    printf("bfo%c msb %d lsb %d rs1 %#018llx: "
+                           "got %#018llx, expected %#018llx\n",
+                           se ? 's' : 'z', msb, lsb, (unsigned long long)a,
+                           (unsigned long long)got,
+                           (unsigned long long)expect);
+                    err = 1;
+                }
+            }
+        }
+    }
+
+    return err;
+}
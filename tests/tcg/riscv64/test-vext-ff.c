@@ -0,0 +1,89 @@
+/*
+ * Check that an op expanded inline for vl < VLMAX honours the vl that a
+ * fault-only-first load leaves behind in the same TB, and leaves the
+ * tail undisturbed.
+ *
+ * Copyright (c) 2023 Andes Technology Corp.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* vs2r.v of the largest supported VLEN */
+#define MAX_GROUP   (2 * 65536 / 8)
+
+/* Bytes readable before the guard page */
+#define READABLE    8
+
+static uint8_t init8[MAX_GROUP], init16[MAX_GROUP], out[MAX_GROUP];
+
+int main(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t vlenb, vl, i;
+    uint8_t *map, *src;
+    int err = 0;
+
+    map = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED || mprotect(map + page, page, PROT_NONE)) {
+        perror("mmap");
+        return 1;
+    }
+    src = map + page - READABLE;
+    for (i = 0; i < READABLE; i++) {
+        src[i] = i + 1;
+    }
+    for (i = 0; i < MAX_GROUP; i++) {
+        init8[i] = 0x80 | i;
+        init16[i] = 0x55;
+    }
+
+    asm volatile("csrr %0, vlenb" : "=r"(vlenb));
+    if (2 * vlenb > MAX_GROUP) {
+        printf("VLEN too large\n");
+        return 1;
+    }
+
+    /*
+     * vl = 16 bytes is below VLMAX for LMUL=2 at any VLEN, and vsetvli
+     * ends the TB, so the load and the add are translated together with
+     * vl known to be 16.  The load faults at element READABLE and cuts
+     * vl down to READABLE; the add must not write past that.
+     */
+    asm volatile("vsetvli zero, %5, e8, m2, ta, ma\n\t"
+                 "vl2r.v v8, (%2)\n\t"
+                 "vl2r.v v16, (%3)\n\t"
+                 "vsetvli zero, %6, e8, m2, tu, mu\n\t"
+                 "vle8ff.v v8, (%4)\n\t"
+                 "vadd.vv v16, v8, v8\n\t"
+                 "csrr %0, vl\n\t"
+                 "vs2r.v v16, (%1)"
+                 : "=&r"(vl)
+                 : "r"(out), "r"(init8), "r"(init16), "r"(src),
+                   "r"(2 * vlenb), "r"(16L)
+                 : "memory");
+
+    if (vl != READABLE) {
+        printf("vle8ff.v: vl %zu, expected %d\n", vl, READABLE);
+        err = 1;
+    }
+    for (i = 0; i < READABLE; i++) {
+        if (out[i] != (uint8_t)(2 * src[i])) {
+            printf("vadd.vv: element %zu is 0x%02x, expected 0x%02x\n",
+                   i, out[i], (uint8_t)(2 * src[i]));
+            err = 1;
+        }
+    }
+    for (; i < 2 * vlenb; i++) {
+        if (out[i] != init16[i]) {
+            printf("vadd.vv: tail element %zu is 0x%02x, expected 0x%02x\n",
+                   i, out[i], init16[i]);
+            err = 1;
+        }
+    }
+    return err;
+}